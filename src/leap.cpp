@@ -10,21 +10,45 @@
 
 #include "Leap.h"
 
+#ifdef WIN_VERSION
+	// must precede windows.h (included by ext.h):
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#pragma comment(lib, "ws2_32.lib")
+#else
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <netdb.h>
+	#include <unistd.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 #include "ext.h"
 #include "ext_obex.h"
 #include "ext_dictobj.h"
+#include "ext_systhread.h"
+#include "ext_atomic.h"
+#include "ext_systime.h"
 #include "jit.common.h"
 #include "jit.gl.h"
+#include "z_dsp.h"
 #ifdef __cplusplus
 }
 #endif
 
+#include "leap_shm.h"
+
 #include <new>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <string>
 
 t_class *leap_class;
+t_class *leap_tilde_class;
 static t_symbol * ps_frame_start;
 static t_symbol * ps_frame_end;
 static t_symbol * ps_frame;
@@ -32,9 +56,41 @@ static t_symbol * ps_hand;
 static t_symbol * ps_finger;
 static t_symbol * ps_palm;
 static t_symbol * ps_ball;
+static t_symbol * ps_arm;
+static t_symbol * ps_fingers;
+static t_symbol * ps_bones;
 static t_symbol * ps_connected;
 static t_symbol * ps_fps;
 static t_symbol * ps_probability;
+static t_symbol * ps_pose;
+static t_symbol * ps_none;
+static t_symbol * ps_left;
+static t_symbol * ps_right;
+static t_symbol * ps_gestures;
+static t_symbol * ps_state;
+static t_symbol * ps_start;
+static t_symbol * ps_update;
+static t_symbol * ps_stop;
+static t_symbol * ps_swipe;
+static t_symbol * ps_circle;
+static t_symbol * ps_key_tap;
+static t_symbol * ps_screen_tap;
+static t_symbol * ps_pointable;
+static t_symbol * ps_duration;
+static t_symbol * ps_startPosition;
+static t_symbol * ps_speed;
+static t_symbol * ps_center;
+static t_symbol * ps_normal;
+static t_symbol * ps_progress;
+static t_symbol * ps_radius;
+static t_symbol * ps_zone;
+static t_symbol * ps_enter;
+static t_symbol * ps_exit;
+static t_symbol * ps_inside;
+static t_symbol * ps_sphere;
+static t_symbol * ps_rule;
+static t_symbol * ps_end;
+static t_symbol * ps_both;
 
 class t_leap {
 public:
@@ -56,12 +112,23 @@ public:
 		}
 		
 		void fromBasis(const Leap::Matrix& basis, bool isRight) {
+			float q[4];
+			fromBasis(basis, isRight, q);
+			atom_setfloat(atoms+0, q[0]);
+			atom_setfloat(atoms+1, q[1]);
+			atom_setfloat(atoms+2, q[2]);
+			atom_setfloat(atoms+3, q[3]);
+		}
+		
+		static void fromBasis(const Leap::Matrix& basis, bool isRight, float * q) {
 			const Leap::Vector& xBasis = basis.xBasis;
 			const Leap::Vector& yBasis = basis.yBasis;
 			const Leap::Vector& zBasis = basis.zBasis;
 			double x, y, z;
 			
-			double w = sqrtf(1.0 + xBasis.x + yBasis.y + zBasis.z) / 2.0;
+			// the left hand basis is mirrored: its x axis is negated below, and so here too
+			// (earlier versions left w un-mirrored, which gave improper left-hand rotations)
+			double w = sqrtf(1.0 + (isRight ? xBasis.x : -xBasis.x) + yBasis.y + zBasis.z) / 2.0;
 			double rw4 = -1./(4.0 * w);
 			
 			// possible that the bases could be flipped
@@ -78,285 +145,4070 @@ public:
 			}
 			// normalize here:
 			double m = 1./sqrtf(x*x+y*y+z*z+w*w);
-			atom_setfloat(atoms+0, x*m);
-			atom_setfloat(atoms+1, y*m);
-			atom_setfloat(atoms+2, z*m);
-			atom_setfloat(atoms+3, w*m);
+			q[0] = x*m;
+			q[1] = y*m;
+			q[2] = z*m;
+			q[3] = w*m;
 		}
 		
 	};
 	
-	// structure of the binary data for frame serialization/deserialization
-	// (needs a header with data length)
-	struct SerializedFrame {
-	public:
-		int32_t length;
-		unsigned char data[16380];	// i.e. total frame size is 16384
+	// plain-data snapshot of a tracked hand, converted once per frame
+	// positions, velocities, lengths & widths are in meters
+	struct BoneData {
+		float prevJoint[3], nextJoint[3], center[3], direction[3];
+		float quat[4];
+		float length, width;
 	};
-
-	class LeapListener : public Leap::Listener {
-	public:
-		t_leap * owner;
-		
-		// do nothing -- we're going to poll with bang() instead:
-//		virtual void onFrame(const Leap::Controller&) {}
-//		virtual void onDeviceChange(const Leap::Controller &) {}
-//		virtual void onFocusGained(const Leap::Controller &) {}
-//		virtual void onFocusLost(const Leap::Controller &) {}
-//		virtual void onServiceConnect(const Leap::Controller &) {}
-//		virtual void onServiceDisconnect(const Leap::Controller &) {}
-//		virtual void onDisconnect(const Leap::Controller &) {}
-	
-		// use this callback to set the policy flags
-		virtual void onConnect(const Leap::Controller&) { owner->configure(); }
+	
+	struct FingerData {
+		int32_t id;
+		int32_t extended;
+		int32_t touchZone;		// Leap::Pointable::Zone
+		float touchDistance;
+		float length, width, timeVisible;
+		float tipPosition[3], stabilizedTipPosition[3], tipVelocity[3], direction[3];
+		BoneData bones[4];		// metacarpal, proximal, intermediate, distal
 	};
-
-    t_object	ob;			// the object itself (must be first)
-    
-	int			unique;		// only output new data
-	int			allframes;	// output all frames between each poll (rather than just the latest frame)
-	int			serialize;	// output serialized frames
-	int 		images;		// output the raw images
-	int			motion_tracking;
-	int			hmd;		// optimize for LeapVR HMD mount
-	int			background;	// capture data even when Max has lost focus
-	int			aka;		// output in a form compatible with aka.leapmotion
 	
-	int			gesture_any;	// accept any gesture
-	int			gesture_swipe, gesture_circle, gesture_screen_tap, gesture_key_tap;	// enable specific gestures
+	struct HandData {
+		int32_t id;
+		int32_t isRight;
+		float confidence, grabStrength, pinchStrength, timeVisible;
+		float palmPosition[3], stabilizedPalmPosition[3], palmNormal[3], direction[3], palmVelocity[3];
+		float palmQuat[4];
+		float palmWidth;
+		float sphereCenter[3], sphereRadius;
+		int32_t armValid;
+		float elbowPosition[3], wristPosition[3], armCenter[3], armDirection[3];
+		float armQuat[4];
+		float armWidth;
+		FingerData fingers[5];	// thumb, index, middle, ring, pinky
+	};
 	
-	t_symbol *	config;
-	t_dictionary * config_dict;
-	t_symbol *	gesture_dict_name;
-	t_dictionary * gesture_dict;
+	struct FrameData {
+		enum { MAX_HANDS = 4 };
+		int64_t id, timestamp;
+		int32_t numHands;
+		int32_t frontmost, leftmost, rightmost;	// hand ids
+		float boxCenter[3], boxSize[3];	// the interaction box
+		HandData hands[MAX_HANDS];
+	};
 	
-	t_symbol * frame_dict_name;
-	t_dictionary * frame_dict;
-	t_symbol *	hand_dict_name;
-	t_dictionary * hand_dict;
-	t_dictionary * arm_dict;
-	t_dictionary * palm_dict;
-	t_dictionary * finger_dicts[5];
-	t_dictionary * bone_dicts[5][4];
+	static void toMeters(const Leap::Vector& v, float * out) {
+		out[0] = v.x * 0.001f;
+		out[1] = v.y * 0.001f;
+		out[2] = v.z * 0.001f;
+	}
 	
-	void *		outlet_frame;
-	void *		outlet_image[2];
-	void *		outlet_hands;
-	void *		outlet_fingers;
-	void *		outlet_gesture;
-	void *		outlet_tracking;
-	void *		outlet_msg;
+	static void toUnit(const Leap::Vector& v, float * out) {
+		out[0] = v.x;
+		out[1] = v.y;
+		out[2] = v.z;
+	}
 	
-	// matrices for the IR images:
-	void *		image_wrappers[2];
-	void *		image_mats[2];
-	void *		distortion_image_wrappers[2];
-	void *		distortion_image_mats[2];
-	int			distortion_dim[2];
-	int			image_width, image_height;
-	int			distortion_requested;
+	static void convertHand(const Leap::Hand& hand, HandData& h) {
+		const bool isRight = hand.isRight();
+		h.id = hand.id();
+		h.isRight = isRight;
+		h.confidence = hand.confidence();
+		h.grabStrength = hand.grabStrength();
+		h.pinchStrength = hand.pinchStrength();
+		h.timeVisible = hand.timeVisible();
+		toMeters(hand.palmPosition(), h.palmPosition);
+		toMeters(hand.stabilizedPalmPosition(), h.stabilizedPalmPosition);
+		toUnit(hand.palmNormal(), h.palmNormal);
+		toUnit(hand.direction(), h.direction);
+		toMeters(hand.palmVelocity(), h.palmVelocity);
+		Quaternion::fromBasis(hand.basis(), isRight, h.palmQuat);
+		h.palmWidth = hand.palmWidth() * 0.001f;
+		toMeters(hand.sphereCenter(), h.sphereCenter);
+		h.sphereRadius = hand.sphereRadius() * 0.001f;
+		
+		const Leap::Arm arm = hand.arm();
+		h.armValid = arm.isValid();
+		if (h.armValid) {
+			toMeters(arm.elbowPosition(), h.elbowPosition);
+			toMeters(arm.wristPosition(), h.wristPosition);
+			toMeters(arm.center(), h.armCenter);
+			toUnit(arm.direction(), h.armDirection);
+			Quaternion::fromBasis(arm.basis(), isRight, h.armQuat);
+			h.armWidth = arm.width() * 0.001f;
+		} else {
+			memset(h.elbowPosition, 0, sizeof(h.elbowPosition));
+			memset(h.wristPosition, 0, sizeof(h.wristPosition));
+			memset(h.armCenter, 0, sizeof(h.armCenter));
+			memset(h.armDirection, 0, sizeof(h.armDirection));
+			h.armQuat[0] = h.armQuat[1] = h.armQuat[2] = 0.f;
+			h.armQuat[3] = 1.f;
+			h.armWidth = 0.f;
+		}
+		
+		const Leap::FingerList fingers = hand.fingers();
+		for (int i=0; i<5; i++) {
+			const Leap::Finger finger = fingers[i];
+			FingerData& f = h.fingers[i];
+			f.id = finger.id();
+			f.extended = finger.isExtended();
+			f.touchZone = (int32_t)finger.touchZone();
+			f.touchDistance = finger.touchDistance();
+			f.length = finger.length() * 0.001f;
+			f.width = finger.width() * 0.001f;
+			f.timeVisible = finger.timeVisible();
+			toMeters(finger.tipPosition(), f.tipPosition);
+			toMeters(finger.stabilizedTipPosition(), f.stabilizedTipPosition);
+			toMeters(finger.tipVelocity(), f.tipVelocity);
+			toUnit(finger.direction(), f.direction);
+			for (int b=0; b<4; b++) {
+				const Leap::Bone bone = finger.bone(static_cast<Leap::Bone::Type>(b));
+				BoneData& d = f.bones[b];
+				toMeters(bone.prevJoint(), d.prevJoint);
+				toMeters(bone.nextJoint(), d.nextJoint);
+				toMeters(bone.center(), d.center);
+				toUnit(bone.direction(), d.direction);
+				Quaternion::fromBasis(bone.basis(), isRight, d.quat);
+				d.length = bone.length() * 0.001f;
+				d.width = bone.width() * 0.001f;
+			}
+		}
+	}
 	
-	Leap::Controller controller;
-	LeapListener listener;
-	Leap::Frame lastFrame;
-	int64_t		lastFrameID;
+	static void convertFrame(const Leap::Frame& frame, FrameData& f) {
+		const Leap::HandList hands = frame.hands();
+		f.id = frame.id();
+		f.timestamp = frame.timestamp();
+		f.frontmost = hands.frontmost().id();
+		f.leftmost = hands.leftmost().id();
+		f.rightmost = hands.rightmost().id();
+		const Leap::InteractionBox box = frame.interactionBox();
+		toMeters(box.center(), f.boxCenter);
+		f.boxSize[0] = box.width() * 0.001f;
+		f.boxSize[1] = box.height() * 0.001f;
+		f.boxSize[2] = box.depth() * 0.001f;
+		f.numHands = 0;
+		for (int i=0; i<hands.count() && f.numHands < FrameData::MAX_HANDS; i++) {
+			const Leap::Hand hand = hands[i];
+			if (!hand.isValid()) continue;
+			convertHand(hand, f.hands[f.numHands++]);
+		}
+	}
 	
-	// the last-received frame:
-	Leap::Frame frame;
+	// joints in a fixed order: palm, wrist, elbow,
+	// then for each finger its 5 joints from the base of the metacarpal to the tip
+	enum { JOINT_PALM, JOINT_WRIST, JOINT_ELBOW, JOINT_FINGERS, NUM_JOINTS = JOINT_FINGERS + 25 };
 	
-	t_leap(int index = 0) {
+	static float * jointPosition(HandData& h, int j) {
+		switch (j) {
+			case JOINT_PALM: return h.palmPosition;
+			case JOINT_WRIST: return h.wristPosition;
+			case JOINT_ELBOW: return h.elbowPosition;
+			default: {
+				j -= JOINT_FINGERS;
+				FingerData& f = h.fingers[j/5];
+				int k = j%5;
+				return k ? f.bones[k-1].nextJoint : f.bones[0].prevJoint;
+			}
+		}
+	}
+	
+	static const float * jointPosition(const HandData& h, int j) {
+		return jointPosition(const_cast<HandData&>(h), j);
+	}
+	
+	static const char * jointName(int j) {
+		static const char * names[NUM_JOINTS] = {
+			"palm", "wrist", "elbow",
+			"thumb_0", "thumb_1", "thumb_2", "thumb_3", "thumb_4",
+			"index_0", "index_1", "index_2", "index_3", "index_4",
+			"middle_0", "middle_1", "middle_2", "middle_3", "middle_4",
+			"ring_0", "ring_1", "ring_2", "ring_3", "ring_4",
+			"pinky_0", "pinky_1", "pinky_2", "pinky_3", "pinky_4"
+		};
+		return names[j];
+	}
+	
+	// every position field of a hand, as float offsets into HandData
+	// (directions, velocities and sizes are not points)
+	enum { NUM_POINTS = 6 + 5*2 + 20*3 };
+	
+	static const int * pointOffsets() {
+		static int offsets[NUM_POINTS];
+		static bool init = false;
+		if (!init) {
+			static HandData h;
+			const float * base = (const float *)&h;
+			int * o = offsets;
+			*o++ = h.palmPosition - base;
+			*o++ = h.stabilizedPalmPosition - base;
+			*o++ = h.sphereCenter - base;
+			*o++ = h.elbowPosition - base;
+			*o++ = h.wristPosition - base;
+			*o++ = h.armCenter - base;
+			for (int f=0; f<5; f++) {
+				const FingerData& finger = h.fingers[f];
+				*o++ = finger.tipPosition - base;
+				*o++ = finger.stabilizedTipPosition - base;
+				for (int b=0; b<4; b++) {
+					*o++ = finger.bones[b].prevJoint - base;
+					*o++ = finger.bones[b].nextJoint - base;
+					*o++ = finger.bones[b].center - base;
+				}
+			}
+			init = true;
+		}
+		return offsets;
+	}
+	
+	// InteractionBox::normalizePoint for every position in the frame at once:
+	// 0..1 across the box, optionally clamped
+	static void normalizeFrame(FrameData& f, bool clamp) {
+		const int * offsets = pointOffsets();
+		float scale[3], offset[3];
+		for (int k=0; k<3; k++) {
+			scale[k] = f.boxSize[k] > 0.f ? 1.f/f.boxSize[k] : 0.f;
+			offset[k] = 0.5f - f.boxCenter[k]*scale[k];
+		}
+		for (int i=0; i<f.numHands; i++) {
+			float * h = (float *)&f.hands[i];
+			for (int p=0; p<NUM_POINTS; p++) {
+				float * v = h + offsets[p];
+				for (int k=0; k<3; k++) {
+					float n = v[k]*scale[k] + offset[k];
+					if (clamp) n = n < 0.f ? 0.f : n > 1.f ? 1.f : n;
+					v[k] = n;
+				}
+			}
+		}
+	}
+	
+	// decimates an output stream to at most hz outputs per second (hz <= 0: every time),
+	// on a microsecond clock; keeps its phase while on time, and resyncs after gaps or jumps back
+	struct RateLimiter {
+		int64_t next;
 		
-		outlet_msg = outlet_new(&ob, 0);
-		outlet_tracking = outlet_new(&ob, 0);
-		outlet_gesture = outlet_new(&ob, 0);
-		outlet_fingers = outlet_new(&ob, "dictionary");
-		outlet_hands = outlet_new(&ob, "dictionary");
-		outlet_image[0] = outlet_new(&ob, "jit_matrix");
-		outlet_image[1] = outlet_new(&ob, "jit_matrix");
-        outlet_frame = outlet_new(&ob, 0);
-
-		// attrs:
-		unique = 0;
-		allframes = 0;
-		images = 1;
-		aka = 0;
-		serialize = 0;
-		motion_tracking = 0;
-		hmd = 0;
-		background = 1;
+		RateLimiter() : next(0) {}
 		
-		gesture_any = 0;
-		gesture_swipe = 0;
-		gesture_circle = 0;
-		gesture_screen_tap = 0;
-		gesture_key_tap = 0;
+		bool due(float hz, int64_t now) {
+			if (hz <= 0.f) return true;
+			const int64_t interval = (int64_t)(1000000. / hz);
+			if (now < next && now >= next - interval) return false;
+			next = (now >= next && now < next + interval) ? next + interval : now + interval;
+			return true;
+		}
+	};
+	
+	// running mean of every position of each hand (by id) between decimated outputs
+	// (other fields keep their latest value)
+	struct PointAverager {
+		float	sum[FrameData::MAX_HANDS][NUM_POINTS*3];
+		int32_t	ids[FrameData::MAX_HANDS];
+		int		count[FrameData::MAX_HANDS];
 		
-		config = jit_symbol_unique();
-		config_dict = dictionary_new();
-		gesture_dict_name = jit_symbol_unique();
-		gesture_dict = dictobj_register(dictionary_new(), &gesture_dict_name);
+		PointAverager() { reset(); }
 		
-		frame_dict_name = jit_symbol_unique();
-		frame_dict = dictobj_register(dictionary_new(), &frame_dict_name);
+		void reset() {
+			for (int i=0; i<FrameData::MAX_HANDS; i++) {
+				ids[i] = -1;
+				count[i] = 0;
+			}
+		}
 		
-		hand_dict_name = jit_symbol_unique();
-		hand_dict = dictobj_register(dictionary_new(), &hand_dict_name);
-		arm_dict = dictionary_new();
-		dictionary_appenddictionary(hand_dict, gensym("arm"), (t_object *)arm_dict);
-		palm_dict = dictionary_new();
-		dictionary_appenddictionary(hand_dict, gensym("palm"), (t_object *)palm_dict);
+		int slot(int32_t id, bool create) {
+			for (int i=0; i<FrameData::MAX_HANDS; i++) if (ids[i] == id) return i;
+			if (!create) return -1;
+			for (int i=0; i<FrameData::MAX_HANDS; i++) {
+				if (ids[i] < 0) {
+					ids[i] = id;
+					for (int k=0; k<NUM_POINTS*3; k++) sum[i][k] = 0.f;
+					return i;
+				}
+			}
+			return -1;
+		}
 		
-		t_dictionary * fingers_dict = dictionary_new();
-		for (int i=0; i<5; i++) {
-			t_symbol * name = 0;
-			t_dictionary * finger = dictionary_new();
-			switch (i) {
-				case 0: name = gensym("thumb"); break;
-				case 1: name = gensym("index"); break;
-				case 2: name = gensym("middle"); break;
-				case 3: name = gensym("ring"); break;
-				case 4: name = gensym("pinky"); break;
-				default: break;
+		void add(const FrameData& f) {
+			const int * offsets = pointOffsets();
+			for (int i=0; i<f.numHands; i++) {
+				const int s = slot(f.hands[i].id, true);
+				if (s < 0) continue;
+				const float * h = (const float *)&f.hands[i];
+				float * acc = sum[s];
+				for (int p=0; p<NUM_POINTS; p++) {
+					const float * v = h + offsets[p];
+					acc[p*3+0] += v[0];
+					acc[p*3+1] += v[1];
+					acc[p*3+2] += v[2];
+				}
+				count[s]++;
 			}
-			dictionary_appendsym(finger, _sym_name, name);
-			dictionary_appenddictionary(fingers_dict, name, (t_object *)finger);
-			finger_dicts[i] = finger;
-			
-			t_dictionary * bones_dict = dictionary_new();
-			for (int b=0; b<4; b++) {
-				t_symbol * name = 0;
-				t_dictionary * bone = dictionary_new();
-				switch (i) {
-					case 0: name = gensym("metacarpal"); break;
-					case 1: name = gensym("proximal"); break;
-					case 2: name = gensym("intermediate"); break;
-					case 3: name = gensym("distal"); break;
-					default: break;
+		}
+		
+		void apply(FrameData& f) {
+			const int * offsets = pointOffsets();
+			for (int i=0; i<f.numHands; i++) {
+				const int s = slot(f.hands[i].id, false);
+				if (s < 0 || count[s] < 2) continue;
+				const float scale = 1.f / count[s];
+				float * h = (float *)&f.hands[i];
+				const float * acc = sum[s];
+				for (int p=0; p<NUM_POINTS; p++) {
+					float * v = h + offsets[p];
+					v[0] = acc[p*3+0] * scale;
+					v[1] = acc[p*3+1] * scale;
+					v[2] = acc[p*3+2] * scale;
 				}
-				dictionary_appendsym(bone, _sym_name, name);
-				dictionary_appenddictionary(bones_dict, name, (t_object *)bone);
-				bone_dicts[i][b] = bone;
 			}
-			dictionary_appenddictionary(finger, gensym("fingers"), (t_object *)bones_dict);
 		}
-		dictionary_appenddictionary(hand_dict, gensym("fingers"), (t_object *)fingers_dict);
+	};
 
+	// single-producer, single-consumer queue, e.g. from the Leap thread to a worker
+	// when full, push fails rather than blocking the producer
+	// (the ATOMIC_ updates of count are full barriers, i.e. release the slot just written
+	// or read; the barrier after each check of count is the matching acquire)
+	template<typename T, int N>
+	struct FrameQueue {
+	public:
+		T items[N];
+		int read, write;		// each owned by one side
+		t_int32_atomic count;
 		
-		// create jit.matrix for the output images:
-		image_width = 0;
-		image_height = 0;
-		distortion_dim[0] = 0;
-		distortion_dim[1] = 0;
-		for (int i=0; i<2; i++) {
-			// create matrix:
-			image_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
-			image_mats[i] = NULL;
-			
-			distortion_image_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
-			distortion_image_mats[i] = NULL;
+		FrameQueue() : read(0), write(0), count(0) {}
+		
+		bool push(const T& v) {
+			if (count >= N) return false;
+			LEAP_SHM_BARRIER();
+			items[write] = v;
+			write = (write + 1) % N;
+			ATOMIC_INCREMENT(&count);
+			return true;
 		}
-		distortion_requested = 1;
 		
-		// internal:
-		lastFrameID = 0;
-		listener.owner = this;
-        controller.addListener(listener);
-    }
-    
-    ~t_leap() {
-		for (int i=0; i<2; i++) {
-			object_release((t_object *)image_wrappers[i]);
+		bool pop(T& v) {
+			if (count <= 0) return false;
+			LEAP_SHM_BARRIER();
+			v = items[read];
+			read = (read + 1) % N;
+			ATOMIC_DECREMENT(&count);
+			return true;
 		}
-		object_release((t_object *)config_dict);
-		object_release((t_object *)gesture_dict);
-		object_release((t_object *)hand_dict);
-    }
+	};
 	
-	void * configureMatrix2D(void * mat_wrapper, long planecount, t_symbol * type, long w, long h) {
-		void * mat = jit_object_method(mat_wrapper, _jit_sym_getmatrix);
-		t_jit_matrix_info info;
-		jit_matrix_info_default(&info);
-		info.flags |= JIT_MATRIX_DATA_PACK_TIGHT;
-		info.planecount = planecount;
-		info.type = type;
-		info.dimcount = 2;
-		info.dim[0] = w;
-		info.dim[1] = h;
-		jit_object_method(mat, _jit_sym_setinfo_ex, &info);
-		return mat;
-	}
+	// receives every converted frame on the Leap thread
+	// implementations must return quickly
+	struct FrameSink {
+	public:
+		virtual ~FrameSink() {}
+		virtual void push(const FrameData& frame) = 0;
+	};
 	
-    void configure() {
-        int flag = Leap::Controller::POLICY_DEFAULT;
-		if (images)		flag |= Leap::Controller::POLICY_IMAGES;
-		if (hmd)		flag |= Leap::Controller::POLICY_OPTIMIZE_HMD;
-		if (background) flag |= Leap::Controller::POLICY_BACKGROUND_FRAMES;
-		controller.setPolicyFlags((Leap::Controller::PolicyFlag)flag);
-		
-		controller.enableGesture(Leap::Gesture::TYPE_SWIPE, (gesture_any || gesture_swipe));
-		controller.enableGesture(Leap::Gesture::TYPE_CIRCLE, (gesture_any || gesture_circle));
-		controller.enableGesture(Leap::Gesture::TYPE_SCREEN_TAP, (gesture_any || gesture_screen_tap));
-		controller.enableGesture(Leap::Gesture::TYPE_KEY_TAP, (gesture_any || gesture_key_tap));
-		
-		// https://developer.leapmotion.com/documentation/cpp/api/Leap.Config.html#cppclass_leap_1_1_config
-		if (dictionary_hasentry(config_dict, gensym("Gesture"))) {
-			t_dictionary * gesture_dict = 0;
-			dictionary_getdictionary(config_dict, gensym("Gesture"), (t_object **)&gesture_dict);
-			double f;
-			
-			if (dictionary_hasentry(config_dict, gensym("Circle"))) {
-				t_dictionary * sub_dict = 0;
-				dictionary_getdictionary(config_dict, gensym("Circle"), (t_object **)&sub_dict);
-				if (dictionary_getfloat(sub_dict, gensym("MinRadius"), &f) == 0) {
-					controller.config().setFloat("Gesture.Circle.MinRadius", f);
-				}
-				if (dictionary_getfloat(sub_dict, gensym("MinArc"), &f) == 0) {
-					controller.config().setFloat("Gesture.Circle.MinArc", f);
-				}
+	// structure of the binary data for frame serialization/deserialization
+	// (needs a header with data length)
+	struct SerializedFrame {
+	public:
+		int32_t length;
+		unsigned char data[16380];	// i.e. total frame size is 16384
+	};
+
+	// nearest-neighbour index of recorded hand poses
+	// samples are stored in one contiguous float array (stride = DIM)
+	// so that a query is a single linear scan over memory
+	struct PoseIndex {
+	public:
+
+		// 5 fingers * 3 bones (proximal, intermediate, distal) * xyz,
+		// plus the thumb tip distance to each other fingertip
+		enum { DIM = 5*3*3 + 4, MAX_K = 16 };
+
+		std::vector<float> samples;		// numSamples * DIM
+		std::vector<int> labels;		// index into names, per sample
+		std::vector<t_symbol *> names;
+
+		size_t size() const { return labels.size(); }
+
+		int label(t_symbol * name) {
+			for (size_t i=0; i<names.size(); i++) {
+				if (names[i] == name) return (int)i;
 			}
-			
-			if (dictionary_hasentry(config_dict, gensym("Swipe"))) {
-				t_dictionary * sub_dict = 0;
-				dictionary_getdictionary(config_dict, gensym("Swipe"), (t_object **)&sub_dict);
-				if (dictionary_getfloat(sub_dict, gensym("MinLength"), &f) == 0) {
-					controller.config().setFloat("Gesture.Swipe.MinLength", f);
-				}
-				if (dictionary_getfloat(sub_dict, gensym("MinVelocity"), &f) == 0) {
-					controller.config().setFloat("Gesture.Swipe.MinVelocity", f);
+			names.push_back(name);
+			return (int)names.size()-1;
+		}
+
+		void add(t_symbol * name, const float * features) {
+			labels.push_back(label(name));
+			samples.insert(samples.end(), features, features+DIM);
+		}
+
+		void remove(t_symbol * name) {
+			size_t w = 0;
+			for (size_t i=0; i<labels.size(); i++) {
+				if (names[labels[i]] == name) continue;
+				if (w != i) {
+					labels[w] = labels[i];
+					memcpy(&samples[w*DIM], &samples[i*DIM], DIM*sizeof(float));
 				}
+				w++;
 			}
-			
-			if (dictionary_hasentry(config_dict, gensym("ScreenTap"))) {
-				t_dictionary * sub_dict = 0;
-				dictionary_getdictionary(config_dict, gensym("ScreenTap"), (t_object **)&sub_dict);
-				if (dictionary_getfloat(sub_dict, gensym("HistorySeconds"), &f) == 0) {
-					controller.config().setFloat("Gesture.ScreenTap.HistorySeconds", f);
-				}
-				if (dictionary_getfloat(sub_dict, gensym("MinDistance"), &f) == 0) {
-					controller.config().setFloat("Gesture.ScreenTap.MinDistance", f);
+			labels.resize(w);
+			samples.resize(w*DIM);
+		}
+
+		void clear() {
+			samples.clear();
+			labels.clear();
+			names.clear();
+		}
+
+		// returns the winning name (or NULL if empty) and its share of the k votes
+		t_symbol * classify(const float * features, int k, float& confidence) const {
+			const size_t n = size();
+			confidence = 0.f;
+			if (n == 0) return NULL;
+			if (k < 1) k = 1;
+			if (k > MAX_K) k = MAX_K;
+			if ((size_t)k > n) k = (int)n;
+
+			// keep the k best in a small sorted array:
+			float best_d[MAX_K];
+			int best_i[MAX_K];
+			int found = 0;
+			const float * s = &samples[0];
+			for (size_t i=0; i<n; i++, s += DIM) {
+				float d = 0.f;
+				for (int j=0; j<DIM; j++) {
+					float e = s[j] - features[j];
+					d += e*e;
 				}
-				if (dictionary_getfloat(sub_dict, gensym("MinForwardVelocity"), &f) == 0) {
-					controller.config().setFloat("Gesture.ScreenTap.MinForwardVelocity", f);
+				if (found < k || d < best_d[found-1]) {
+					int j = (found < k) ? found++ : found-1;
+					while (j > 0 && best_d[j-1] > d) {
+						best_d[j] = best_d[j-1];
+						best_i[j] = best_i[j-1];
+						j--;
+					}
+					best_d[j] = d;
+					best_i[j] = (int)i;
 				}
 			}
-			
-			if (dictionary_hasentry(config_dict, gensym("KeyTap"))) {
-				t_dictionary * sub_dict = 0;
-				dictionary_getdictionary(config_dict, gensym("KeyTap"), (t_object **)&sub_dict);
-				if (dictionary_getfloat(sub_dict, gensym("HistorySeconds"), &f) == 0) {
-					controller.config().setFloat("Gesture.KeyTap.HistorySeconds", f);
-				}
-				if (dictionary_getfloat(sub_dict, gensym("MinDistance"), &f) == 0) {
-					controller.config().setFloat("Gesture.KeyTap.MinDistance", f);
-				}
-				if (dictionary_getfloat(sub_dict, gensym("MinDownVelocity"), &f) == 0) {
-					controller.config().setFloat("Gesture.KeyTap.MinDownVelocity", f);
-				}
+
+			// distance-weighted vote:
+			std::vector<float> votes(names.size(), 0.f);
+			float total = 0.f;
+			for (int i=0; i<found; i++) {
+				float w = 1.f / (sqrtf(best_d[i]) + 0.001f);
+				votes[labels[best_i[i]]] += w;
+				total += w;
+			}
+			int winner = 0;
+			for (size_t i=1; i<votes.size(); i++) {
+				if (votes[i] > votes[winner]) winner = (int)i;
 			}
-			controller.config().save();
+			confidence = votes[winner] / total;
+			return names[winner];
 		}
+
+		// hand-local, scale-normalized features
+		// the hand basis is mirrored for left hands (x always points toward the pinky),
+		// so both hands share the same poses
+		// (pose files without a version were written when left hands were mirrored twice,
+		// i.e. not at all: their left-hand samples don't match, see poseRead)
+		enum { FILE_VERSION = 2 };
+		static void features(const HandData& h, float * out) {
+			const float * n = h.palmNormal;
+			const float * d = h.direction;
+			const float side = h.isRight ? 1.f : -1.f;
+			const float xb[3] = {
+				side * (n[1]*d[2] - n[2]*d[1]),
+				side * (n[2]*d[0] - n[0]*d[2]),
+				side * (n[0]*d[1] - n[1]*d[0])
+			};
+			float scale = (h.palmWidth > 0.f) ? 1.f/h.palmWidth : 0.f;
+
+			float * f = out;
+			for (int i=0; i<5; i++) {
+				for (int b=1; b<4; b++) {
+					const float * v = h.fingers[i].bones[b].direction;
+					*f++ = v[0]*xb[0] + v[1]*xb[1] + v[2]*xb[2];
+					*f++ = -(v[0]*n[0] + v[1]*n[1] + v[2]*n[2]);
+					*f++ = -(v[0]*d[0] + v[1]*d[1] + v[2]*d[2]);
+				}
+			}
+			const float * thumb = h.fingers[0].tipPosition;
+			for (int i=1; i<5; i++) {
+				const float * tip = h.fingers[i].tipPosition;
+				float dx = tip[0]-thumb[0], dy = tip[1]-thumb[1], dz = tip[2]-thumb[2];
+				*f++ = sqrtf(dx*dx + dy*dy + dz*dz) * scale;
+			}
+		}
+	};
+
+	// Leap service settings that can be set from the @config dictionary,
+	// e.g. { "Gesture" : { "Circle" : { "MinRadius" : 5. } } }
+	// see https://developer.leapmotion.com/documentation/cpp/api/Leap.Config.html#cppclass_leap_1_1_config
+	struct ConfigKey {
+		const char * group;		// sub-dictionary of "Gesture"
+		const char * key;
+		const char * path;		// Leap::Config key
+	};
+	enum { NUM_CONFIG_KEYS = 10 };
+	
+	static const ConfigKey * configKeys() {
+		static const ConfigKey keys[NUM_CONFIG_KEYS] = {
+			{ "Circle", "MinRadius", "Gesture.Circle.MinRadius" },
+			{ "Circle", "MinArc", "Gesture.Circle.MinArc" },
+			{ "Swipe", "MinLength", "Gesture.Swipe.MinLength" },
+			{ "Swipe", "MinVelocity", "Gesture.Swipe.MinVelocity" },
+			{ "ScreenTap", "HistorySeconds", "Gesture.ScreenTap.HistorySeconds" },
+			{ "ScreenTap", "MinDistance", "Gesture.ScreenTap.MinDistance" },
+			{ "ScreenTap", "MinForwardVelocity", "Gesture.ScreenTap.MinForwardVelocity" },
+			{ "KeyTap", "HistorySeconds", "Gesture.KeyTap.HistorySeconds" },
+			{ "KeyTap", "MinDistance", "Gesture.KeyTap.MinDistance" },
+			{ "KeyTap", "MinDownVelocity", "Gesture.KeyTap.MinDownVelocity" }
+		};
+		return keys;
+	}
+	
+	// one Leap::Controller per process, shared by every [leap] instance
+	// each frame is converted once into a FrameData, which instances copy out
+	struct Hub {
+	public:
+		
+		class LeapListener : public Leap::Listener {
+		public:
+			Hub * hub;
+			
+			// instances poll with bang(), but sinks (e.g. @stream) receive every frame here:
+			virtual void onFrame(const Leap::Controller& controller) { hub->onFrame(controller.frame()); }
+			
+			// do nothing:
+//			virtual void onDeviceChange(const Leap::Controller &) {}
+//			virtual void onFocusGained(const Leap::Controller &) {}
+//			virtual void onFocusLost(const Leap::Controller &) {}
+//			virtual void onServiceConnect(const Leap::Controller &) {}
+//			virtual void onServiceDisconnect(const Leap::Controller &) {}
+//			virtual void onDisconnect(const Leap::Controller &) {}
+			
+			// use this callback to set the policy flags
+			// (the service may have restarted, so everything is pushed again)
+			virtual void onConnect(const Leap::Controller&) { hub->reconfigure(); }
+		};
+		
+		// recently converted frames, indexed by frame id
+		// (large enough to cover the controller's history for @allframes)
+		enum { CACHE_SIZE = 64 };
+		
+		Leap::Controller controller;
+		LeapListener listener;
+		std::vector<t_leap *> clients;
+		std::vector<FrameSink *> sinks;
+		t_systhread_mutex mutex;
+		FrameData cache[CACHE_SIZE];
+		
+		static Hub * instance;
+		
+		int refs;	// clients, plus users that only add sinks (e.g. [leap~])
+		
+		// configuration requests are coalesced into one deferred configure()
+		t_qelem * configure_qelem;
+		
+		// what was last pushed to the service, so that only changes are sent:
+		int			applied_flags;		// -1 = unknown
+		int			applied_gestures[4];
+		float		applied_config[NUM_CONFIG_KEYS];
+		bool		applied_config_valid[NUM_CONFIG_KEYS];
+		
+		// client may be NULL for users that only need the controller and sinks
+		static Hub * acquire(t_leap * client) {
+			if (!instance) instance = new Hub;
+			systhread_mutex_lock(instance->mutex);
+			if (client) instance->clients.push_back(client);
+			instance->refs++;
+			systhread_mutex_unlock(instance->mutex);
+			return instance;
+		}
+		
+		static void release(t_leap * client) {
+			if (!instance) return;
+			systhread_mutex_lock(instance->mutex);
+			std::vector<t_leap *>& clients = instance->clients;
+			clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+			bool empty = (--instance->refs == 0);
+			systhread_mutex_unlock(instance->mutex);
+			if (empty) {
+				delete instance;
+				instance = NULL;
+			} else {
+				// the remaining clients may need less:
+				instance->requestConfigure();
+			}
+		}
+		
+		Hub() : refs(0) {
+			systhread_mutex_new(&mutex, 0);
+			for (int i=0; i<CACHE_SIZE; i++) cache[i].id = -1;
+			configure_qelem = qelem_new(this, (method)configureTick);
+			forget();
+			listener.hub = this;
+			controller.addListener(listener);
+		}
+		
+		~Hub() {
+			controller.removeListener(listener);
+			qelem_free(configure_qelem);
+			systhread_mutex_free(mutex);
+		}
+		
+		// copy the converted frame into out, converting it only if no other instance has yet
+		void convert(const Leap::Frame& frame, FrameData& out) {
+			const int64_t id = frame.id();
+			FrameData& cached = cache[id % CACHE_SIZE];
+			systhread_mutex_lock(mutex);
+			if (cached.id != id) convertFrame(frame, cached);
+			out = cached;
+			systhread_mutex_unlock(mutex);
+		}
+		
+		void addSink(FrameSink * sink) {
+			systhread_mutex_lock(mutex);
+			sinks.push_back(sink);
+			systhread_mutex_unlock(mutex);
+		}
+		
+		void removeSink(FrameSink * sink) {
+			systhread_mutex_lock(mutex);
+			sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+			systhread_mutex_unlock(mutex);
+		}
+		
+		// Leap thread: convert (once) and hand to the sinks
+		void onFrame(const Leap::Frame& frame) {
+			if (!frame.isValid()) return;
+			systhread_mutex_lock(mutex);
+			if (sinks.size()) {
+				const int64_t id = frame.id();
+				FrameData& cached = cache[id % CACHE_SIZE];
+				if (cached.id != id) convertFrame(frame, cached);
+				for (size_t i=0; i<sinks.size(); i++) sinks[i]->push(cached);
+			}
+			systhread_mutex_unlock(mutex);
+		}
+		
+		// schedule a configure() on the main thread;
+		// any number of requests before it runs (e.g. several attributes set at once) cost one
+		void requestConfigure() {
+			qelem_set(configure_qelem);
+		}
+		
+		// push everything again, e.g. after the service (re)connects
+		void reconfigure() {
+			systhread_mutex_lock(mutex);
+			forget();
+			systhread_mutex_unlock(mutex);
+			requestConfigure();
+		}
+		
+		static void configureTick(Hub * hub) {
+			hub->configure();
+		}
+		
+		void forget() {
+			applied_flags = -1;
+			for (int i=0; i<4; i++) applied_gestures[i] = -1;
+			for (int i=0; i<NUM_CONFIG_KEYS; i++) applied_config_valid[i] = false;
+		}
+		
+		// reconcile the policies of all instances, and push only what differs from the last push:
+		// images, background frames and gestures are enabled if any instance wants them
+		// (instances filter their own outputs); HMD mode changes tracking for everyone,
+		// so it is enabled if any instance asks for it, with a warning to the others
+		// config keys set by several instances take the value of the most recent instance
+		// users that only add sinks (e.g. [leap~]) count too: they need background frames,
+		// as audio keeps running when Max loses focus
+		void configure() {
+			systhread_mutex_lock(mutex);
+			const int sink_users = refs - (int)clients.size();
+			if (clients.empty() && sink_users <= 0) {
+				systhread_mutex_unlock(mutex);
+				return;
+			}
+			int images = 0, hmd = 0, background = sink_users > 0;
+			int gestures[4] = { 0, 0, 0, 0 };	// swipe, circle, screen tap, key tap
+			float config_values[NUM_CONFIG_KEYS];
+			bool config_wanted[NUM_CONFIG_KEYS];
+			for (int k=0; k<NUM_CONFIG_KEYS; k++) config_wanted[k] = false;
+			for (size_t i=0; i<clients.size(); i++) {
+				const t_leap * x = clients[i];
+				images |= x->images;
+				hmd |= x->hmd;
+				background |= x->background;
+				gestures[0] |= x->gesture_any || x->gesture_swipe;
+				gestures[1] |= x->gesture_any || x->gesture_circle;
+				gestures[2] |= x->gesture_any || x->gesture_screen_tap;
+				gestures[3] |= x->gesture_any || x->gesture_key_tap;
+				for (int k=0; k<NUM_CONFIG_KEYS; k++) {
+					if (x->config_valid[k]) {
+						config_values[k] = x->config_values[k];
+						config_wanted[k] = true;
+					}
+				}
+			}
+			
+			int flag = Leap::Controller::POLICY_DEFAULT;
+			if (images)		flag |= Leap::Controller::POLICY_IMAGES;
+			if (hmd)		flag |= Leap::Controller::POLICY_OPTIMIZE_HMD;
+			if (background) flag |= Leap::Controller::POLICY_BACKGROUND_FRAMES;
+			if (flag != applied_flags) {
+				controller.setPolicyFlags((Leap::Controller::PolicyFlag)flag);
+				if (hmd && !(applied_flags > 0 && (applied_flags & Leap::Controller::POLICY_OPTIMIZE_HMD))) {
+					for (size_t i=0; i<clients.size(); i++) {
+						t_leap * x = clients[i];
+						if (!x->hmd) object_warn(&x->ob, "another [leap] has enabled @hmd, which applies to all instances");
+					}
+				}
+				applied_flags = flag;
+			}
+			
+			static const Leap::Gesture::Type types[4] = {
+				Leap::Gesture::TYPE_SWIPE, Leap::Gesture::TYPE_CIRCLE,
+				Leap::Gesture::TYPE_SCREEN_TAP, Leap::Gesture::TYPE_KEY_TAP
+			};
+			for (int i=0; i<4; i++) {
+				if (gestures[i] != applied_gestures[i]) {
+					controller.enableGesture(types[i], gestures[i] != 0);
+					applied_gestures[i] = gestures[i];
+				}
+			}
+			
+			bool changed = false;
+			Leap::Config config = controller.config();
+			const ConfigKey * keys = configKeys();
+			for (int k=0; k<NUM_CONFIG_KEYS; k++) {
+				if (config_wanted[k] && !(applied_config_valid[k] && applied_config[k] == config_values[k])) {
+					config.setFloat(keys[k].path, config_values[k]);
+					applied_config[k] = config_values[k];
+					applied_config_valid[k] = true;
+					changed = true;
+				}
+			}
+			if (changed) config.save();
+			systhread_mutex_unlock(mutex);
+		}
+	};
+
+	// sends frames to host:port targets as OSC bundles or compact binary datagrams
+	// frames arrive on the Leap thread and are packed & sent by a dedicated thread,
+	// never touching the Max scheduler
+	struct UdpStreamer : public FrameSink {
+	public:
+		enum { FORMAT_OSC = 1, FORMAT_BINARY = 2 };
+		enum { PACKET_SIZE = 8192 };
+		
+		FrameQueue<FrameData, 8> queue;
+		std::vector<sockaddr_in> targets;
+		int			format;
+		long		dropped;
+		
+		int			sock;
+		t_systhread	thread;
+		t_systhread_mutex mutex;	// guards targets & the wakeup condition
+		t_systhread_cond cond;
+		volatile int running;
+		
+		char		packet[PACKET_SIZE];
+		size_t		size;
+		
+		UdpStreamer(int format) : format(format), dropped(0), thread(0), running(1), size(0) {
+#ifdef WIN_VERSION
+			WSADATA wsa;
+			WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+			sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+			systhread_mutex_new(&mutex, 0);
+			systhread_cond_new(&cond, 0);
+			systhread_create((method)run, this, 0, 0, 0, &thread);
+		}
+		
+		~UdpStreamer() {
+			unsigned int ret;
+			systhread_mutex_lock(mutex);
+			running = 0;
+			systhread_cond_signal(cond);
+			systhread_mutex_unlock(mutex);
+			systhread_join(thread, &ret);
+			systhread_cond_free(cond);
+			systhread_mutex_free(mutex);
+#ifdef WIN_VERSION
+			closesocket(sock);
+			WSACleanup();
+#else
+			close(sock);
+#endif
+		}
+		
+		bool addTarget(const char * host, int port) {
+			addrinfo hints, * res = NULL;
+			memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_DGRAM;
+			if (getaddrinfo(host, NULL, &hints, &res) || !res) return false;
+			sockaddr_in addr = *(sockaddr_in *)res->ai_addr;
+			addr.sin_port = htons((unsigned short)port);
+			freeaddrinfo(res);
+			systhread_mutex_lock(mutex);
+			targets.push_back(addr);
+			systhread_mutex_unlock(mutex);
+			return true;
+		}
+		
+		void clearTargets() {
+			systhread_mutex_lock(mutex);
+			targets.clear();
+			systhread_mutex_unlock(mutex);
+		}
+		
+		// Leap thread:
+		virtual void push(const FrameData& frame) {
+			if (!queue.push(frame)) {
+				dropped++;
+				return;
+			}
+			systhread_mutex_lock(mutex);
+			systhread_cond_signal(cond);
+			systhread_mutex_unlock(mutex);
+		}
+		
+		static void * run(UdpStreamer * self) {
+			FrameData * frame = new FrameData;
+			while (self->running) {
+				systhread_mutex_lock(self->mutex);
+				while (self->running && self->queue.count <= 0) {
+					systhread_cond_wait(self->cond, self->mutex);
+				}
+				systhread_mutex_unlock(self->mutex);
+				
+				while (self->running && self->queue.pop(*frame)) {
+					if (self->format == FORMAT_BINARY) {
+						self->packBinary(*frame);
+					} else {
+						self->packOSC(*frame);
+					}
+					self->send();
+				}
+			}
+			delete frame;
+			systhread_exit(0);
+			return NULL;
+		}
+		
+		void send() {
+			systhread_mutex_lock(mutex);
+			for (size_t i=0; i<targets.size(); i++) {
+				sendto(sock, packet, (int)size, 0, (const sockaddr *)&targets[i], sizeof(sockaddr_in));
+			}
+			systhread_mutex_unlock(mutex);
+		}
+		
+		// big-endian writers:
+		void pad() {
+			while (size & 3) packet[size++] = 0;
+		}
+		void i32(int32_t v) {
+			uint32_t u = htonl((uint32_t)v);
+			memcpy(packet+size, &u, 4);
+			size += 4;
+		}
+		void i64(int64_t v) {
+			i32((int32_t)((uint64_t)v >> 32));
+			i32((int32_t)((uint64_t)v & 0xffffffff));
+		}
+		void f32(float v) {
+			int32_t u;
+			memcpy(&u, &v, 4);
+			i32(u);
+		}
+		void f32(const float * v, int n) {
+			for (int i=0; i<n; i++) f32(v[i]);
+		}
+		void str(const char * s) {
+			size_t n = strlen(s) + 1;
+			memcpy(packet+size, s, n);
+			size += n;
+			pad();
+		}
+		
+		// OSC message header: address, then type tags (ints first, then floats)
+		// returns the offset of the bundle element size, to be patched by endMessage()
+		size_t beginMessage(const char * address, int numInt, int numInt64, int numFloat) {
+			size_t start = size;
+			size += 4;
+			str(address);
+			char tags[256];
+			int t = 0;
+			tags[t++] = ',';
+			for (int i=0; i<numInt; i++) tags[t++] = 'i';
+			for (int i=0; i<numInt64; i++) tags[t++] = 'h';
+			for (int i=0; i<numFloat; i++) tags[t++] = 'f';
+			tags[t] = 0;
+			str(tags);
+			return start;
+		}
+		void endMessage(size_t start) {
+			uint32_t u = htonl((uint32_t)(size - start - 4));
+			memcpy(packet+start, &u, 4);
+		}
+		
+		/*
+			OSC bundle per frame (positions in meters, quats as x y z w):
+			/leap/frame <num hands> <frame id (h)> <timestamp (h)>
+			per hand:
+			/leap/hand <hand id> <right> <confidence> <grab> <pinch> <palm position xyz> <palm normal xyz>
+				<direction xyz> <palm velocity xyz> <palm quat xyzw> <palm width>
+			/leap/joints <hand id> <palm, wrist, elbow, then 5 joints per finger, xyz each>
+			/leap/bones <hand id> <quat xyzw for each finger's metacarpal, proximal, intermediate, distal>
+		*/
+		void packOSC(const FrameData& frame) {
+			size = 0;
+			str("#bundle");
+			i32(0);
+			i32(1);		// timetag: immediately
+			
+			size_t m = beginMessage("/leap/frame", 1, 2, 0);
+			i32(frame.numHands);
+			i64(frame.id);
+			i64(frame.timestamp);
+			endMessage(m);
+			
+			for (int i=0; i<frame.numHands; i++) {
+				const HandData& h = frame.hands[i];
+				
+				m = beginMessage("/leap/hand", 2, 0, 21);
+				i32(h.id);
+				i32(h.isRight);
+				f32(h.confidence);
+				f32(h.grabStrength);
+				f32(h.pinchStrength);
+				f32(h.palmPosition, 3);
+				f32(h.palmNormal, 3);
+				f32(h.direction, 3);
+				f32(h.palmVelocity, 3);
+				f32(h.palmQuat, 4);
+				f32(h.palmWidth);
+				endMessage(m);
+				
+				m = beginMessage("/leap/joints", 1, 0, NUM_JOINTS*3);
+				i32(h.id);
+				for (int j=0; j<NUM_JOINTS; j++) f32(jointPosition(h, j), 3);
+				endMessage(m);
+				
+				m = beginMessage("/leap/bones", 1, 0, 20*4);
+				i32(h.id);
+				for (int f=0; f<5; f++) {
+					for (int b=0; b<4; b++) f32(h.fingers[f].bones[b].quat, 4);
+				}
+				endMessage(m);
+			}
+		}
+		
+		/*
+			binary datagram per frame (all values big-endian):
+			'LEAP' <version int32 = 1> <frame id int64> <timestamp int64> <num hands int32>
+			per hand:
+			<hand id int32> <right int32> then float32:
+				<confidence> <grab> <pinch> <palm normal xyz> <direction xyz> <palm velocity xyz> <palm quat xyzw> <palm width>
+				<joint positions xyz, NUM_JOINTS in the order of /leap/joints>
+				<bone quats xyzw, in the order of /leap/bones>
+		*/
+		void packBinary(const FrameData& frame) {
+			size = 0;
+			memcpy(packet, "LEAP", 4);
+			size = 4;
+			i32(1);
+			i64(frame.id);
+			i64(frame.timestamp);
+			i32(frame.numHands);
+			for (int i=0; i<frame.numHands; i++) {
+				const HandData& h = frame.hands[i];
+				i32(h.id);
+				i32(h.isRight);
+				f32(h.confidence);
+				f32(h.grabStrength);
+				f32(h.pinchStrength);
+				f32(h.palmNormal, 3);
+				f32(h.direction, 3);
+				f32(h.palmVelocity, 3);
+				f32(h.palmQuat, 4);
+				f32(h.palmWidth);
+				for (int j=0; j<NUM_JOINTS; j++) f32(jointPosition(h, j), 3);
+				for (int f=0; f<5; f++) {
+					for (int b=0; b<4; b++) f32(h.fingers[f].bones[b].quat, 4);
+				}
+			}
+		}
+	};
+
+	// publishes every converted frame to a named shared-memory region (see leap_shm.h)
+	// the Leap thread is the single writer; readers in other processes never block it
+	struct ShmPublisher : public FrameSink {
+	public:
+		leap_shm_region * region;
+#ifdef WIN_VERSION
+		HANDLE		mapping;
+#else
+		char		path[256];
+#endif
+		
+		ShmPublisher(const char * name) : region(NULL) {
+			const size_t size = sizeof(leap_shm_region);
+			void * ptr = NULL;
+#ifdef WIN_VERSION
+			mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, name);
+			if (mapping) ptr = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+			snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+			int fd = shm_open(path, O_CREAT | O_RDWR, 0644);
+			if (fd >= 0) {
+				if (ftruncate(fd, size) == 0) {
+					ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+					if (ptr == MAP_FAILED) ptr = NULL;
+				}
+				close(fd);
+			}
+#endif
+			if (ptr) {
+				region = (leap_shm_region *)ptr;
+				memset(region, 0, size);
+				region->size = (uint32_t)size;
+				region->version = LEAP_SHM_VERSION;
+				LEAP_SHM_BARRIER();
+				region->magic = LEAP_SHM_MAGIC;
+			}
+		}
+		
+		~ShmPublisher() {
+			if (region) {
+				region->magic = 0;
+				leap_shm_close(region);
+			}
+#ifdef WIN_VERSION
+			if (mapping) CloseHandle(mapping);
+#else
+			shm_unlink(path);
+#endif
+		}
+		
+		// Leap thread:
+		virtual void push(const FrameData& frame) {
+			if (!region) return;
+			leap_shm_frame& out = region->frame;
+			
+			region->sequence++;		// odd: writing
+			LEAP_SHM_BARRIER();
+			
+			out.id = frame.id;
+			out.timestamp = frame.timestamp;
+			out.num_hands = frame.numHands < LEAP_SHM_MAX_HANDS ? frame.numHands : LEAP_SHM_MAX_HANDS;
+			for (int i=0; i<out.num_hands; i++) {
+				const HandData& h = frame.hands[i];
+				leap_shm_hand& o = out.hands[i];
+				o.id = h.id;
+				o.is_right = h.isRight;
+				o.confidence = h.confidence;
+				o.grab_strength = h.grabStrength;
+				o.pinch_strength = h.pinchStrength;
+				o.palm_width = h.palmWidth;
+				memcpy(o.palm_normal, h.palmNormal, sizeof(o.palm_normal));
+				memcpy(o.direction, h.direction, sizeof(o.direction));
+				memcpy(o.palm_velocity, h.palmVelocity, sizeof(o.palm_velocity));
+				memcpy(o.palm_quat, h.palmQuat, sizeof(o.palm_quat));
+				for (int j=0; j<NUM_JOINTS; j++) memcpy(o.joints[j], jointPosition(h, j), sizeof(float)*3);
+				for (int f=0; f<5; f++) {
+					for (int b=0; b<4; b++) memcpy(o.bone_quats[f*4+b], h.fingers[f].bones[b].quat, sizeof(float)*4);
+				}
+			}
+			
+			LEAP_SHM_BARRIER();
+			region->sequence++;		// even: consistent
+		}
+	};
+
+	/*
+		columnar export of hand data, one row per hand per frame
+		
+		file layout (little-endian):
+		header:	"LEAPCOL2" <uint32 num columns>
+				per column: <uint8 type (0 int32, 1 int64, 2 float32)> <uint8 name length> <name>
+				zero padding to a multiple of 64 bytes
+		chunks:	"CHNK" <uint32 num rows> <uint32 reserved> <uint32 reserved>
+				per column: <uint64 byte length> <uint64 reserved>, zero padding to a multiple
+				of 64 bytes, then the values, zero-padded to a multiple of 64 bytes
+		footer:	"END!" <uint32 num chunks> <uint64 num rows>
+		
+		Every column buffer is contiguous, 64-byte aligned and has no nulls, i.e. it
+		matches the Arrow columnar memory layout and can be wrapped as an Arrow array
+		(or converted to Parquet) without copying. Joint positions are in meters,
+		velocities in meters per second. Readers should find columns by name.
+		
+		Chunks are written by a background thread, so the caller never waits on disk
+		(unless created unthreaded, for callers that write whole chunks themselves).
+	*/
+	struct ColumnarWriter {
+	public:
+		enum { TYPE_INT32, TYPE_INT64, TYPE_FLOAT32 };
+		enum { ROWS_PER_CHUNK = 4096 };
+		enum { COL_FRAME, COL_TIMESTAMP, COL_HAND, COL_RIGHT, COL_CONFIDENCE, COL_GRAB, COL_PINCH,
+			COL_QUAT, COL_NORMAL = COL_QUAT + 4, COL_JOINTS = COL_NORMAL + 3,
+			COL_VELOCITY = COL_JOINTS + NUM_JOINTS*3,	// palm, then fingertips thumb..pinky
+			COL_BONE_QUATS = COL_VELOCITY + 6*3,		// metacarpal..distal, thumb..pinky
+			NUM_COLUMNS = COL_BONE_QUATS + 20*4 };
+		
+		struct Chunk {
+			std::vector<char> columns[NUM_COLUMNS];
+			uint32_t rows;
+			
+			Chunk() : rows(0) {
+				for (int c=0; c<NUM_COLUMNS; c++) columns[c].resize(ROWS_PER_CHUNK * columnWidth(c));
+			}
+			
+			template<typename T>
+			void set(int c, uint32_t row, T v) {
+				memcpy(&columns[c][row * sizeof(T)], &v, sizeof(T));
+			}
+			
+			// append a row for a hand; the caller checks that rows < ROWS_PER_CHUNK
+			void append(const FrameData& frame, const HandData& h) {
+				const uint32_t row = rows++;
+				set<int64_t>(COL_FRAME, row, frame.id);
+				set<int64_t>(COL_TIMESTAMP, row, frame.timestamp);
+				set<int32_t>(COL_HAND, row, h.id);
+				set<int32_t>(COL_RIGHT, row, h.isRight);
+				set<float>(COL_CONFIDENCE, row, h.confidence);
+				set<float>(COL_GRAB, row, h.grabStrength);
+				set<float>(COL_PINCH, row, h.pinchStrength);
+				for (int k=0; k<4; k++) set<float>(COL_QUAT + k, row, h.palmQuat[k]);
+				for (int k=0; k<3; k++) set<float>(COL_NORMAL + k, row, h.palmNormal[k]);
+				for (int j=0; j<NUM_JOINTS; j++) {
+					const float * p = jointPosition(h, j);
+					for (int k=0; k<3; k++) set<float>(COL_JOINTS + j*3 + k, row, p[k]);
+				}
+				for (int k=0; k<3; k++) set<float>(COL_VELOCITY + k, row, h.palmVelocity[k]);
+				for (int f=0; f<5; f++) {
+					for (int k=0; k<3; k++) set<float>(COL_VELOCITY + (f+1)*3 + k, row, h.fingers[f].tipVelocity[k]);
+					for (int b=0; b<4; b++) {
+						for (int k=0; k<4; k++) set<float>(COL_BONE_QUATS + (f*4+b)*4 + k, row, h.fingers[f].bones[b].quat[k]);
+					}
+				}
+			}
+		};
+		
+		FILE *		file;
+		uint64_t	offset;		// bytes written so far (ftell is 32-bit on Windows)
+		Chunk		chunks[2];
+		Chunk *		filling;
+		Chunk *		pending;	// handed to the writer thread
+		uint32_t	numChunks;
+		uint64_t	numRows;
+		
+		t_systhread	thread;
+		t_systhread_mutex mutex;
+		t_systhread_cond cond;
+		volatile int running;
+		
+		static int columnType(int c) {
+			if (c == COL_FRAME || c == COL_TIMESTAMP) return TYPE_INT64;
+			if (c == COL_HAND || c == COL_RIGHT) return TYPE_INT32;
+			return TYPE_FLOAT32;
+		}
+		
+		static size_t columnWidth(int c) {
+			return columnType(c) == TYPE_INT64 ? 8 : 4;
+		}
+		
+		static void columnName(int c, char * name) {
+			static const char * fixed[] = { "frame", "timestamp", "hand", "right", "confidence", "grabStrength", "pinchStrength",
+				"palm_qx", "palm_qy", "palm_qz", "palm_qw", "palm_nx", "palm_ny", "palm_nz" };
+			static const char * axes[] = { "x", "y", "z", "w" };
+			static const char * fingers[] = { "thumb", "index", "middle", "ring", "pinky" };
+			static const char * bones[] = { "metacarpal", "proximal", "intermediate", "distal" };
+			if (c < COL_JOINTS) {
+				strcpy(name, fixed[c]);
+			} else if (c < COL_VELOCITY) {
+				c -= COL_JOINTS;
+				snprintf(name, 64, "%s_%s", jointName(c/3), axes[c%3]);
+			} else if (c < COL_BONE_QUATS) {
+				c -= COL_VELOCITY;
+				snprintf(name, 64, "%s_v%s", c < 3 ? "palm" : fingers[c/3 - 1], axes[c%3]);
+			} else {
+				c -= COL_BONE_QUATS;
+				snprintf(name, 64, "%s_%s_q%s", fingers[c/16], bones[(c/4)%4], axes[c%4]);
+			}
+		}
+		
+		ColumnarWriter(FILE * file, bool threaded = true) : file(file), offset(0), filling(chunks), pending(NULL), numChunks(0), numRows(0), thread(0), running(1) {
+			
+			// header:
+			put("LEAPCOL2", 8);
+			uint32_t n = NUM_COLUMNS;
+			put(&n, 4);
+			for (int c=0; c<NUM_COLUMNS; c++) {
+				char name[64];
+				columnName(c, name);
+				uint8_t meta[2] = { (uint8_t)columnType(c), (uint8_t)strlen(name) };
+				put(meta, 2);
+				put(name, meta[1]);
+			}
+			pad();
+			
+			systhread_mutex_new(&mutex, 0);
+			systhread_cond_new(&cond, 0);
+			if (threaded) systhread_create((method)run, this, 0, 0, 0, &thread);
+		}
+		
+		// flushes any partial chunk and closes the file
+		~ColumnarWriter() {
+			unsigned int ret;
+			if (filling->rows) submit();
+			systhread_mutex_lock(mutex);
+			while (pending) systhread_cond_wait(cond, mutex);
+			running = 0;
+			systhread_cond_broadcast(cond);
+			systhread_mutex_unlock(mutex);
+			if (thread) systhread_join(thread, &ret);
+			systhread_cond_free(cond);
+			systhread_mutex_free(mutex);
+			
+			put("END!", 4);
+			put(&numChunks, 4);
+			put(&numRows, 8);
+			fclose(file);
+		}
+		
+		void put(const void * data, size_t size) {
+			fwrite(data, 1, size, file);
+			offset += size;
+		}
+		
+		void pad() {
+			static const char zeros[64] = { 0 };
+			if (offset % 64) put(zeros, (size_t)(64 - offset % 64));
+		}
+		
+		void append(const FrameData& frame) {
+			for (int i=0; i<frame.numHands; i++) {
+				filling->append(frame, frame.hands[i]);
+				if (filling->rows == ROWS_PER_CHUNK) submit();
+			}
+		}
+		
+		// hand the full chunk to the writer thread and continue in the other one
+		void submit() {
+			systhread_mutex_lock(mutex);
+			while (pending) systhread_cond_wait(cond, mutex);
+			pending = filling;
+			filling = (filling == chunks) ? chunks+1 : chunks;
+			filling->rows = 0;
+			systhread_cond_broadcast(cond);
+			systhread_mutex_unlock(mutex);
+		}
+		
+		// (called directly only by unthreaded writers)
+		void write(const Chunk& chunk) {
+			uint32_t head[4] = { 0, chunk.rows, 0, 0 };
+			memcpy(head, "CHNK", 4);
+			put(head, sizeof(head));
+			for (int c=0; c<NUM_COLUMNS; c++) {
+				uint64_t meta[2] = { chunk.rows * columnWidth(c), 0 };
+				put(meta, sizeof(meta));
+				pad();	// the values start 64-byte aligned
+				put(&chunk.columns[c][0], (size_t)meta[0]);
+				pad();
+			}
+			numChunks++;
+			numRows += chunk.rows;
+		}
+		
+		static void * run(ColumnarWriter * self) {
+			systhread_mutex_lock(self->mutex);
+			while (self->running) {
+				if (self->pending) {
+					Chunk * chunk = self->pending;
+					systhread_mutex_unlock(self->mutex);
+					self->write(*chunk);
+					systhread_mutex_lock(self->mutex);
+					self->pending = NULL;
+					systhread_cond_broadcast(self->cond);
+				} else {
+					systhread_cond_wait(self->cond, self->mutex);
+				}
+			}
+			systhread_mutex_unlock(self->mutex);
+			systhread_exit(0);
+			return NULL;
+		}
+	};
+
+	static int numCores() {
+#ifdef WIN_VERSION
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return (int)info.dwNumberOfProcessors;
+#else
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		return n > 0 ? (int)n : 1;
+#endif
+	}
+	
+	// a fixed set of worker threads for data-parallel jobs:
+	// run(job, n) calls job->execute(i, worker) for every i in 0..n-1, spread over the workers,
+	// and returns once all of them are done
+	struct WorkerPool {
+	public:
+		struct Job {
+			virtual ~Job() {}
+			virtual void execute(int index, int worker) = 0;
+		};
+		
+		struct Worker {
+			WorkerPool * pool;
+			int index;
+			t_systhread thread;
+		};
+		
+		std::vector<Worker> workers;
+		t_systhread_mutex mutex;
+		t_systhread_cond wake, done;
+		Job *		job;
+		int			next, count, remaining;
+		volatile int running;
+		
+		WorkerPool(int n) : job(NULL), next(0), count(0), remaining(0), running(1) {
+			systhread_mutex_new(&mutex, 0);
+			systhread_cond_new(&wake, 0);
+			systhread_cond_new(&done, 0);
+			workers.resize(n < 1 ? 1 : n);
+			for (size_t i=0; i<workers.size(); i++) {
+				workers[i].pool = this;
+				workers[i].index = (int)i;
+				systhread_create((method)loop, &workers[i], 0, 0, 0, &workers[i].thread);
+			}
+		}
+		
+		~WorkerPool() {
+			unsigned int ret;
+			systhread_mutex_lock(mutex);
+			running = 0;
+			systhread_cond_broadcast(wake);
+			systhread_mutex_unlock(mutex);
+			for (size_t i=0; i<workers.size(); i++) systhread_join(workers[i].thread, &ret);
+			systhread_cond_free(done);
+			systhread_cond_free(wake);
+			systhread_mutex_free(mutex);
+		}
+		
+		int size() const { return (int)workers.size(); }
+		
+		void run(Job * j, int n) {
+			if (n <= 0) return;
+			systhread_mutex_lock(mutex);
+			job = j;
+			next = 0;
+			count = remaining = n;
+			systhread_cond_broadcast(wake);
+			while (remaining) systhread_cond_wait(done, mutex);
+			job = NULL;
+			systhread_mutex_unlock(mutex);
+		}
+		
+		static void * loop(Worker * w) {
+			WorkerPool * self = w->pool;
+			systhread_mutex_lock(self->mutex);
+			while (self->running) {
+				if (self->job && self->next < self->count) {
+					Job * j = self->job;
+					int i = self->next++;
+					systhread_mutex_unlock(self->mutex);
+					j->execute(i, w->index);
+					systhread_mutex_lock(self->mutex);
+					if (--self->remaining == 0) systhread_cond_broadcast(self->done);
+				} else {
+					systhread_cond_wait(self->wake, self->mutex);
+				}
+			}
+			systhread_mutex_unlock(self->mutex);
+			systhread_exit(0);
+			return NULL;
+		}
+	};
+	
+
+	// blob tracking on the IR images (@blobs 1), both cameras in parallel on worker threads:
+	// a running-average background model (8.8 fixed point) learned where there is no foreground,
+	// foreground where a pixel is brighter than the background by the threshold,
+	// then 4-connected components by two-pass labelling with union-find
+	struct BlobTracker : public WorkerPool::Job {
+	public:
+		enum { MAX_BLOBS = 16 };
+		
+		struct Blob {
+			float	cx, cy;		// centroid, weighted by brightness above the background
+			int		area;		// pixels
+			int		x0, y0, x1, y1;	// bounding box, inclusive
+			float	weight;
+			
+			bool operator<(const Blob& other) const { return area > other.area; }
+		};
+		
+		struct Camera {
+			std::vector<uint16_t> background;
+			std::vector<uint8_t> mask;		// brightness above the background, 0 if not foreground
+			std::vector<int32_t> labels;
+			std::vector<int32_t> parents;
+			std::vector<Blob> stats;
+			std::vector<Blob> blobs;		// largest first
+			const uint8_t * pixels;
+		};
+		
+		Camera		cameras[2];
+		WorkerPool	pool;
+		int			width, height;
+		int			threshold;	// 0..255
+		int			rate;		// background learning rate, 0..256 (of 256)
+		int			minArea;
+		bool		reset;		// take the next images as the background
+		
+		BlobTracker() : pool(2), width(0), height(0), threshold(24), rate(5), minArea(16), reset(true) {}
+		
+		// pixels[camera] may be NULL
+		void run(const uint8_t * pixels[2], int w, int h) {
+			if (w != width || h != height) {
+				width = w;
+				height = h;
+				reset = true;
+			}
+			for (int c=0; c<2; c++) {
+				cameras[c].pixels = pixels[c];
+				cameras[c].blobs.clear();
+			}
+			pool.run(this, 2);
+			reset = false;
+		}
+		
+		static int32_t find(std::vector<int32_t>& parents, int32_t l) {
+			while (parents[l] != l) {
+				parents[l] = parents[parents[l]];
+				l = parents[l];
+			}
+			return l;
+		}
+		
+		virtual void execute(int index, int /*worker*/) {
+			Camera& cam = cameras[index];
+			const uint8_t * pixels = cam.pixels;
+			if (!pixels) return;
+			const int n = width * height;
+			
+			// subtract & threshold, then update the background (kept simple enough to vectorize):
+			if (reset || (int)cam.background.size() != n) {
+				cam.background.resize(n);
+				for (int i=0; i<n; i++) cam.background[i] = (uint16_t)(pixels[i] << 8);
+			}
+			cam.mask.resize(n);
+			uint16_t * bg = &cam.background[0];
+			uint8_t * mask = &cam.mask[0];
+			const int t = threshold << 8;
+			const int r = rate;
+			for (int i=0; i<n; i++) {
+				const int diff = (pixels[i] << 8) - bg[i];
+				const int fg = diff > t;
+				mask[i] = (uint8_t)(fg ? (diff >> 8) : 0);
+				bg[i] = (uint16_t)(bg[i] + (fg ? 0 : (diff * r) >> 8));
+			}
+			
+			// first pass: provisional labels, merging equivalent ones:
+			cam.labels.resize(n);
+			std::vector<int32_t>& parents = cam.parents;
+			parents.clear();
+			parents.push_back(0);
+			int32_t * labels = &cam.labels[0];
+			for (int y=0, i=0; y<height; y++) {
+				for (int x=0; x<width; x++, i++) {
+					if (!mask[i]) {
+						labels[i] = 0;
+						continue;
+					}
+					const int32_t up = y ? labels[i-width] : 0;
+					const int32_t left = x ? labels[i-1] : 0;
+					int32_t l;
+					if (up && left) {
+						const int32_t a = find(parents, up), b = find(parents, left);
+						l = a < b ? a : b;
+						parents[a > b ? a : b] = l;
+					} else if (up || left) {
+						l = up ? up : left;
+					} else {
+						l = (int32_t)parents.size();
+						parents.push_back(l);
+					}
+					labels[i] = l;
+				}
+			}
+			
+			// second pass: accumulate per component:
+			std::vector<Blob>& stats = cam.stats;
+			stats.resize(parents.size());
+			for (size_t l=0; l<stats.size(); l++) {
+				Blob& b = stats[l];
+				b.cx = b.cy = b.weight = 0.f;
+				b.area = 0;
+				b.x0 = width; b.y0 = height; b.x1 = b.y1 = -1;
+			}
+			for (int y=0, i=0; y<height; y++) {
+				for (int x=0; x<width; x++, i++) {
+					if (!labels[i]) continue;
+					Blob& b = stats[find(parents, labels[i])];
+					const float w = mask[i];
+					b.cx += w * x;
+					b.cy += w * y;
+					b.weight += w;
+					b.area++;
+					if (x < b.x0) b.x0 = x;
+					if (x > b.x1) b.x1 = x;
+					if (y < b.y0) b.y0 = y;
+					if (y > b.y1) b.y1 = y;
+				}
+			}
+			for (size_t l=1; l<stats.size(); l++) {
+				Blob& b = stats[l];
+				if (b.area < minArea) continue;
+				b.cx /= b.weight;
+				b.cy /= b.weight;
+				cam.blobs.push_back(b);
+			}
+			std::sort(cam.blobs.begin(), cam.blobs.end());
+			if (cam.blobs.size() > MAX_BLOBS) cam.blobs.resize(MAX_BLOBS);
+		}
+	};
+
+	/*
+		session recording (record <file>), replayed in real time by play <file>
+		and offline by batch <file>
+		
+		file layout (little-endian):
+		header:	"LEAPREC1" <uint32 version = 2> <uint32 reserved>
+		then a sequence of records, each <uint32 byte length> <payload>:
+		frame:	length < 0x80000000, payload: Leap::Frame::serialize() bytes
+		image:	length | 0x80000000 (IMAGE_RECORD), payload: <uint8 camera> <uint8 keyframe>
+				<uint16 width> <uint16 height> <uint16 reserved> <ImageCodec bytes>
+				an IR image of the frame record before it (version 1 files have none)
+	*/
+	enum { RECORDING_VERSION = 2 };
+	static const uint32_t IMAGE_RECORD = 0x80000000u;
+	
+	/*
+		lossless coding of 8-bit IR images for recordings
+		
+		Each pixel is predicted from its left, upper and upper-left neighbours (the LOCO-I
+		median edge detector). Unless it is a keyframe, this is applied to the difference from
+		the previous image of the same camera, which is near zero wherever nothing moved.
+		Residuals are Rice-coded, with the parameter adapted to the recent residual magnitudes.
+	*/
+	struct ImageCodec {
+	public:
+		enum { ESCAPE = 24 };	// unary prefixes this long are followed by the raw residual
+		
+		struct Adapt {
+			int sum, count;
+			Adapt() : sum(4), count(1) {}
+			int k() const {
+				int k = 0;
+				while ((count << k) < sum && k < 7) k++;
+				return k;
+			}
+			void update(int u) {
+				sum += u;
+				if (++count == 64) {
+					sum >>= 1;
+					count >>= 1;
+				}
+			}
+		};
+		
+		// the value being predicted: the pixel, or its signed difference from the previous image
+		static inline int value(const uint8_t * cur, const uint8_t * prev, int i) {
+			return prev ? (int)(int8_t)(uint8_t)(cur[i] - prev[i]) : (int)cur[i];
+		}
+		
+		static inline int predict(const uint8_t * cur, const uint8_t * prev, int x, int y, int width) {
+			const int i = y*width + x;
+			if (y == 0) return x ? value(cur, prev, i-1) : 0;
+			const int b = value(cur, prev, i-width);
+			if (x == 0) return b;
+			const int a = value(cur, prev, i-1);
+			const int c = value(cur, prev, i-width-1);
+			const int hi = a > b ? a : b, lo = a < b ? a : b;
+			return c >= hi ? lo : c <= lo ? hi : a + b - c;
+		}
+		
+		// appends the coded image to out; prev is NULL for a keyframe
+		static void encode(const uint8_t * cur, const uint8_t * prev, int width, int height, std::vector<uint8_t>& out) {
+			Adapt adapt;
+			uint64_t acc = 0;
+			int bits = 0;
+			for (int y=0; y<height; y++) {
+				for (int x=0; x<width; x++) {
+					const int e = (int8_t)(uint8_t)(value(cur, prev, y*width + x) - predict(cur, prev, x, y, width));
+					const uint32_t u = e >= 0 ? 2*e : -2*e - 1;
+					const int k = adapt.k();
+					const uint32_t q = u >> k;
+					if (q < ESCAPE) {
+						acc = (acc << (q + 1 + k)) | (1u << k) | (u & ((1u << k) - 1));
+						bits += q + 1 + k;
+					} else {
+						acc = (acc << (ESCAPE + 1 + 8)) | (1u << 8) | u;
+						bits += ESCAPE + 1 + 8;
+					}
+					while (bits >= 8) {
+						bits -= 8;
+						out.push_back((uint8_t)(acc >> bits));
+					}
+					adapt.update(u);
+				}
+			}
+			if (bits) out.push_back((uint8_t)(acc << (8 - bits)));
+		}
+		
+		// returns false if the data ran out
+		static bool decode(const uint8_t * data, size_t len, const uint8_t * prev, int width, int height, uint8_t * cur) {
+			const uint8_t * end = data + len;
+			Adapt adapt;
+			uint64_t acc = 0;
+			int bits = 0;
+			for (int y=0; y<height; y++) {
+				for (int x=0; x<width; x++) {
+					// unary prefix:
+					int q = 0;
+					for (;;) {
+						if (bits == 0) {
+							if (data == end) return false;
+							acc = (acc << 8) | *data++;
+							bits = 8;
+						}
+						bits--;
+						if ((acc >> bits) & 1) break;
+						if (++q > ESCAPE) return false;
+					}
+					const int k = q < ESCAPE ? adapt.k() : 8;
+					while (bits < k) {
+						acc = (acc << 8) | (data < end ? *data++ : 0);
+						bits += 8;
+					}
+					bits -= k;
+					const uint32_t low = (uint32_t)(acc >> bits) & ((1u << k) - 1);
+					const uint32_t u = q < ESCAPE ? ((uint32_t)q << k) | low : low;
+					const int e = (u & 1) ? -(int)((u + 1) >> 1) : (int)(u >> 1);
+					const int i = y*width + x;
+					const uint8_t v = (uint8_t)(predict(cur, prev, x, y, width) + e);
+					cur[i] = prev ? (uint8_t)(prev[i] + v) : v;
+					adapt.update(u);
+				}
+			}
+			return true;
+		}
+	};
+	
+	// writes a session recording on a background thread, which also codes the images:
+	// addImage() for each image of a frame, then addFrame()
+	struct RecordingWriter {
+	public:
+		enum { KEYFRAME_INTERVAL = 60, MAX_PENDING = 8 };	// frames queued beyond this are recorded without images
+		
+		struct Image {
+			int camera, width, height;
+			std::vector<uint8_t> pixels;
+		};
+		
+		struct Entry {
+			std::string frame;
+			std::vector<Image> images;
+			size_t numImages;
+			Entry() : numImages(0) {}
+		};
+		
+		FILE *		file;
+		Entry *		next;		// being filled by the Max thread
+		std::vector<Entry *> queue;
+		std::vector<Entry *> spare;	// recycled entries
+		long		dropped;	// images not recorded because the coder fell behind
+		
+		// coder state (writer thread only):
+		std::vector<uint8_t> prev[2];
+		int			prevWidth[2], prevHeight[2];
+		int			sinceKey[2];
+		std::vector<uint8_t> coded;
+		
+		t_systhread	thread;
+		t_systhread_mutex mutex;
+		t_systhread_cond cond;
+		volatile int running;
+		
+		RecordingWriter(FILE * file) : file(file), next(NULL), dropped(0), thread(0), running(1) {
+			uint32_t head[2] = { RECORDING_VERSION, 0 };
+			fwrite("LEAPREC1", 1, 8, file);
+			fwrite(head, 4, 2, file);
+			for (int c=0; c<2; c++) {
+				prevWidth[c] = prevHeight[c] = 0;
+				sinceKey[c] = 0;
+			}
+			systhread_mutex_new(&mutex, 0);
+			systhread_cond_new(&cond, 0);
+			systhread_create((method)run, this, 0, 0, 0, &thread);
+		}
+		
+		// writes whatever is queued, then closes the file
+		~RecordingWriter() {
+			unsigned int ret;
+			systhread_mutex_lock(mutex);
+			running = 0;
+			systhread_cond_broadcast(cond);
+			systhread_mutex_unlock(mutex);
+			systhread_join(thread, &ret);
+			systhread_cond_free(cond);
+			systhread_mutex_free(mutex);
+			delete next;
+			for (size_t i=0; i<spare.size(); i++) delete spare[i];
+			fclose(file);
+		}
+		
+		Entry * entry() {
+			if (!next) {
+				systhread_mutex_lock(mutex);
+				if (spare.size()) {
+					next = spare.back();
+					spare.pop_back();
+				}
+				systhread_mutex_unlock(mutex);
+				if (!next) next = new Entry;
+				next->numImages = 0;
+			}
+			return next;
+		}
+		
+		void addImage(int camera, const unsigned char * pixels, int width, int height) {
+			if (camera < 0 || camera > 1) return;
+			Entry * e = entry();
+			systhread_mutex_lock(mutex);
+			const bool full = queue.size() >= MAX_PENDING;
+			systhread_mutex_unlock(mutex);
+			if (full) {
+				dropped++;
+				return;
+			}
+			if (e->images.size() <= e->numImages) e->images.resize(e->numImages + 1);
+			Image& image = e->images[e->numImages++];
+			image.camera = camera;
+			image.width = width;
+			image.height = height;
+			image.pixels.assign(pixels, pixels + width*height);
+		}
+		
+		void addFrame(const std::string& data) {
+			Entry * e = entry();
+			e->frame = data;
+			systhread_mutex_lock(mutex);
+			queue.push_back(e);
+			systhread_cond_broadcast(cond);
+			systhread_mutex_unlock(mutex);
+			next = NULL;
+		}
+		
+		void write(Entry& e) {
+			uint32_t len = (uint32_t)e.frame.size();
+			fwrite(&len, 4, 1, file);
+			fwrite(e.frame.data(), 1, len, file);
+			for (size_t i=0; i<e.numImages; i++) {
+				Image& image = e.images[i];
+				const int c = image.camera;
+				const bool key = sinceKey[c] >= KEYFRAME_INTERVAL || prevWidth[c] != image.width || prevHeight[c] != image.height;
+				coded.clear();
+				ImageCodec::encode(&image.pixels[0], key ? NULL : &prev[c][0], image.width, image.height, coded);
+				
+				uint8_t head[8] = { (uint8_t)c, (uint8_t)key, 0, 0, 0, 0, 0, 0 };
+				const uint16_t dim[2] = { (uint16_t)image.width, (uint16_t)image.height };
+				memcpy(head+2, dim, 4);
+				len = (uint32_t)(sizeof(head) + coded.size()) | IMAGE_RECORD;
+				fwrite(&len, 4, 1, file);
+				fwrite(head, 1, sizeof(head), file);
+				if (coded.size()) fwrite(&coded[0], 1, coded.size(), file);
+				
+				prev[c].swap(image.pixels);
+				prevWidth[c] = image.width;
+				prevHeight[c] = image.height;
+				sinceKey[c] = key ? 1 : sinceKey[c] + 1;
+			}
+		}
+		
+		static void * run(RecordingWriter * self) {
+			std::vector<Entry *> batch;
+			systhread_mutex_lock(self->mutex);
+			while (self->running || self->queue.size()) {
+				if (self->queue.size()) {
+					batch.swap(self->queue);
+					systhread_mutex_unlock(self->mutex);
+					for (size_t i=0; i<batch.size(); i++) self->write(*batch[i]);
+					systhread_mutex_lock(self->mutex);
+					self->spare.insert(self->spare.end(), batch.begin(), batch.end());
+					batch.clear();
+				} else {
+					systhread_cond_wait(self->cond, self->mutex);
+				}
+			}
+			systhread_mutex_unlock(self->mutex);
+			systhread_exit(0);
+			return NULL;
+		}
+	};
+	
+	// reads a session recording one frame at a time, with the images recorded for it
+	struct RecordingReader {
+	public:
+		FILE *		file;
+		Leap::Frame	frame;		// the current frame
+		std::vector<std::vector<uint8_t> > images;	// its image records
+		size_t		numImages;
+		std::vector<uint8_t> buffer;
+		uint32_t	lookahead;	// length of a frame record already read, or 0
+		
+		// decoder state:
+		std::vector<uint8_t> prev[2], decoded;
+		int			width[2], height[2];
+		
+		RecordingReader() : file(NULL), numImages(0), lookahead(0) {
+			width[0] = width[1] = height[0] = height[1] = 0;
+		}
+		
+		~RecordingReader() {
+			if (file) fclose(file);
+		}
+		
+		bool open(const char * path) {
+			file = fopen(path, "rb");
+			if (!file) return false;
+			char magic[8];
+			uint32_t head[2];
+			return fread(magic, 1, 8, file) == 8 && !memcmp(magic, "LEAPREC1", 8) && fread(head, 4, 2, file) == 2;
+		}
+		
+		// advance to the next frame; returns false at the end
+		bool next() {
+			bool have = false;
+			numImages = 0;
+			for (;;) {
+				uint32_t len = lookahead;
+				lookahead = 0;
+				if (!len && fread(&len, 4, 1, file) != 1) return have;
+				if (len & IMAGE_RECORD) {
+					len &= ~IMAGE_RECORD;
+					if (!have) {
+						if (fseek(file, len, SEEK_CUR)) return false;
+						continue;
+					}
+					if (images.size() <= numImages) images.resize(numImages + 1);
+					std::vector<uint8_t>& record = images[numImages];
+					record.resize(len);
+					if (len < 8 || fread(&record[0], 1, len, file) != len) return true;
+					numImages++;
+					continue;
+				}
+				if (have) {
+					lookahead = len;
+					return true;
+				}
+				buffer.resize(len ? len : 1);
+				if (fread(&buffer[0], 1, len, file) != len) return false;
+				frame.deserialize(&buffer[0], (int)len);
+				have = true;
+			}
+		}
+		
+		// decode the current frame's i'th image (in order); returns its camera, or -1
+		int image(size_t i, const uint8_t ** pixels, int * w, int * h) {
+			const std::vector<uint8_t>& record = images[i];
+			const int c = record[0];
+			const bool key = record[1] != 0;
+			uint16_t dim[2];
+			memcpy(dim, &record[2], 4);
+			if (c > 1 || (!key && (width[c] != dim[0] || height[c] != dim[1]))) return -1;
+			decoded.resize((size_t)dim[0] * dim[1]);
+			if (decoded.empty() || !ImageCodec::decode(&record[8], record.size() - 8, key ? NULL : &prev[c][0], dim[0], dim[1], &decoded[0])) {
+				width[c] = height[c] = 0;	// wait for the next keyframe
+				return -1;
+			}
+			prev[c].swap(decoded);
+			width[c] = dim[0];
+			height[c] = dim[1];
+			*pixels = &prev[c][0];
+			*w = dim[0];
+			*h = dim[1];
+			return c;
+		}
+		
+		// the current frame's i'th image isn't decoded: the next deltas from its camera
+		// would be decoded against a stale image, so wait for the next keyframe
+		void skip(size_t i) {
+			const int c = images[i][0];
+			if (c <= 1) width[c] = height[c] = 0;
+		}
+	};
+	
+	// offline feature extraction over a recording, with no Max clock involved:
+	// the recording is indexed, then blocks of frames are deserialized and converted in parallel
+	// (one columnar chunk per block) and written in order by the coordinating thread
+	struct BatchJob : public WorkerPool::Job {
+	public:
+		enum { BLOCK_FRAMES = ColumnarWriter::ROWS_PER_CHUNK / FrameData::MAX_HANDS };
+		
+		std::vector<uint64_t> offsets;	// of each frame's length field
+		std::string	inpath;
+		std::vector<FILE *> inputs;		// one per worker
+		ColumnarWriter * writer;
+		WorkerPool	pool;
+		std::vector<ColumnarWriter::Chunk> chunks;	// one per block in flight
+		int			wave;		// first block of the current wave
+		
+		t_systhread	thread;
+		volatile int cancelled;
+		volatile int finished;
+		t_qelem *	notify;		// set when finished
+		t_int32_atomic failed;	// frames that couldn't be read
+		double		seconds;
+		
+		BatchJob(const char * inpath, ColumnarWriter * writer, int threads, t_qelem * notify)
+		: inpath(inpath), writer(writer), pool(threads), wave(0), thread(0),
+		  cancelled(0), finished(0), notify(notify), failed(0), seconds(0) {
+			chunks.resize(pool.size());
+			inputs.resize(pool.size(), (FILE *)NULL);
+		}
+		
+		~BatchJob() {
+			unsigned int ret;
+			cancelled = 1;
+			if (thread) systhread_join(thread, &ret);
+			for (size_t i=0; i<inputs.size(); i++) if (inputs[i]) fclose(inputs[i]);
+			delete writer;
+		}
+		
+		// read the index of frame offsets; returns false if this isn't a recording
+		bool index() {
+			FILE * f = fopen(inpath.c_str(), "rb");
+			if (!f) return false;
+			char magic[8];
+			uint32_t head[2];
+			bool ok = fread(magic, 1, 8, f) == 8 && !memcmp(magic, "LEAPREC1", 8) && fread(head, 4, 2, f) == 2;
+			uint64_t pos = 16;
+			uint32_t len;
+			while (ok && fread(&len, 4, 1, f) == 1) {
+				if (!(len & IMAGE_RECORD)) offsets.push_back(pos);
+				len &= ~IMAGE_RECORD;
+				pos += 4 + len;
+				if (fseek(f, len, SEEK_CUR)) break;
+			}
+			fclose(f);
+			for (size_t i=0; ok && i<inputs.size(); i++) {
+				inputs[i] = fopen(inpath.c_str(), "rb");
+				ok = inputs[i] != NULL;
+			}
+			return ok;
+		}
+		
+		void start() {
+			systhread_create((method)coordinate, this, 0, 0, 0, &thread);
+		}
+		
+		static int seek(FILE * f, uint64_t pos) {
+#ifdef WIN_VERSION
+			return _fseeki64(f, (__int64)pos, SEEK_SET);
+#else
+			return fseeko(f, (off_t)pos, SEEK_SET);
+#endif
+		}
+		
+		// worker: convert one block of frames into chunks[index]
+		// (blocks are contiguous in the file, so each is read sequentially)
+		virtual void execute(int index, int worker) {
+			ColumnarWriter::Chunk& chunk = chunks[index];
+			chunk.rows = 0;
+			const size_t first = (size_t)(wave + index) * BLOCK_FRAMES;
+			const size_t last = std::min(first + BLOCK_FRAMES, offsets.size());
+			FILE * in = inputs[worker];
+			if (first >= last || seek(in, offsets[first])) return;
+			std::vector<unsigned char> buffer;
+			Leap::Frame frame;
+			FrameData f;
+			for (size_t i=first; i<last && !cancelled; i++) {
+				uint32_t len = 0;
+				if (fread(&len, 4, 1, in) != 1) break;
+				if (len & IMAGE_RECORD) {
+					// images aren't extracted
+					if (fseek(in, len & ~IMAGE_RECORD, SEEK_CUR)) break;
+					i--;
+					continue;
+				}
+				buffer.resize(len ? len : 1);
+				if (fread(&buffer[0], 1, len, in) != len) break;
+				frame.deserialize(&buffer[0], (int)len);
+				if (!len || !frame.isValid()) {
+					ATOMIC_INCREMENT(&failed);
+					continue;
+				}
+				convertFrame(frame, f);
+				for (int h=0; h<f.numHands; h++) chunk.append(f, f.hands[h]);
+			}
+		}
+		
+		static void * coordinate(BatchJob * self) {
+			const double start = systimer_gettime();
+			const int blocks = (int)((self->offsets.size() + BLOCK_FRAMES - 1) / BLOCK_FRAMES);
+			for (self->wave = 0; self->wave < blocks && !self->cancelled; self->wave += self->pool.size()) {
+				const int n = std::min(self->pool.size(), blocks - self->wave);
+				self->pool.run(self, n);
+				for (int i=0; i<n; i++) {
+					if (self->chunks[i].rows) self->writer->write(self->chunks[i]);
+				}
+			}
+			self->seconds = (systimer_gettime() - start) * 0.001;
+			self->finished = 1;
+			qelem_set(self->notify);
+			systhread_exit(0);
+			return NULL;
+		}
+	};
+
+	// quaternion helpers (x y z w)
+	static void quatMul(const float * a, const float * b, float * out) {
+		const float x = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1];
+		const float y = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0];
+		const float z = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3];
+		const float w = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+		out[0] = x; out[1] = y; out[2] = z; out[3] = w;
+	}
+	
+	static void quatConj(const float * q, float * out) {
+		out[0] = -q[0]; out[1] = -q[1]; out[2] = -q[2]; out[3] = q[3];
+	}
+	
+	static void quatRotate(const float * q, const float * v, float * out) {
+		// v + 2w(u x v) + 2u x (u x v)
+		const float * u = q;
+		const float t[3] = {
+			2.f*(u[1]*v[2] - u[2]*v[1]),
+			2.f*(u[2]*v[0] - u[0]*v[2]),
+			2.f*(u[0]*v[1] - u[1]*v[0])
+		};
+		out[0] = v[0] + q[3]*t[0] + (u[1]*t[2] - u[2]*t[1]);
+		out[1] = v[1] + q[3]*t[1] + (u[2]*t[0] - u[0]*t[2]);
+		out[2] = v[2] + q[3]*t[2] + (u[0]*t[1] - u[1]*t[0]);
+	}
+
+	// the other fields of a hand that a world transform acts on, as float offsets into HandData:
+	// unit directions and velocities (rotated & scaled), quaternions (rotated), sizes (scaled)
+	enum { NUM_DIRECTIONS = 3 + 5 + 20, NUM_VELOCITIES = 1 + 5, NUM_QUATS = 2 + 20, NUM_SIZES = 3 + 5*2 + 20*2 };
+	
+	struct FieldOffsets {
+		int directions[NUM_DIRECTIONS], velocities[NUM_VELOCITIES], quats[NUM_QUATS], sizes[NUM_SIZES];
+	};
+	
+	static const FieldOffsets& fieldOffsets() {
+		static FieldOffsets offsets;
+		static bool init = false;
+		if (!init) {
+			static HandData h;
+			const float * base = (const float *)&h;
+			int * d = offsets.directions, * v = offsets.velocities, * q = offsets.quats, * s = offsets.sizes;
+			*d++ = h.palmNormal - base;
+			*d++ = h.direction - base;
+			*d++ = h.armDirection - base;
+			*v++ = h.palmVelocity - base;
+			*q++ = h.palmQuat - base;
+			*q++ = h.armQuat - base;
+			*s++ = &h.palmWidth - base;
+			*s++ = &h.sphereRadius - base;
+			*s++ = &h.armWidth - base;
+			for (int f=0; f<5; f++) {
+				const FingerData& finger = h.fingers[f];
+				*d++ = finger.direction - base;
+				*v++ = finger.tipVelocity - base;
+				*s++ = &finger.length - base;
+				*s++ = &finger.width - base;
+				for (int b=0; b<4; b++) {
+					*d++ = finger.bones[b].direction - base;
+					*q++ = finger.bones[b].quat - base;
+					*s++ = &finger.bones[b].length - base;
+					*s++ = &finger.bones[b].width - base;
+				}
+			}
+			init = true;
+		}
+		return offsets;
+	}
+	
+	// an affine map from tracking space (meters, after conversion) into world space (@axes, world),
+	// composed once per frame and applied to every field of every hand in one pass
+	struct WorldTransform {
+	public:
+		float	m[3][4];	// rows of the 3x4 affine matrix
+		float	q[4];		// its rotation
+		float	scale;		// its (uniform) scale
+		
+		WorldTransform() { identity(); }
+		
+		void identity() {
+			for (int r=0; r<3; r++) for (int c=0; c<4; c++) m[r][c] = (r == c) ? 1.f : 0.f;
+			q[0] = q[1] = q[2] = 0.f;
+			q[3] = 1.f;
+			scale = 1.f;
+		}
+		
+		bool isIdentity() const {
+			for (int r=0; r<3; r++) for (int c=0; c<4; c++) if (m[r][c] != ((r == c) ? 1.f : 0.f)) return false;
+			return true;
+		}
+		
+		// from a column-major 4x4 matrix (as in jitter & OpenGL)
+		void setMatrix(const float * in) {
+			for (int r=0; r<3; r++) for (int c=0; c<4; c++) m[r][c] = in[c*4 + r];
+			update();
+		}
+		
+		// from a position and an x y z w quaternion
+		void setPose(const float * p, const float * rot) {
+			float n = sqrtf(rot[0]*rot[0] + rot[1]*rot[1] + rot[2]*rot[2] + rot[3]*rot[3]);
+			n = n > 0.f ? 1.f/n : 0.f;
+			const float x = rot[0]*n, y = rot[1]*n, z = rot[2]*n, w = rot[3]*n;
+			m[0][0] = 1.f - 2.f*(y*y + z*z);	m[0][1] = 2.f*(x*y - z*w);		m[0][2] = 2.f*(x*z + y*w);
+			m[1][0] = 2.f*(x*y + z*w);		m[1][1] = 1.f - 2.f*(x*x + z*z);	m[1][2] = 2.f*(y*z - x*w);
+			m[2][0] = 2.f*(x*z - y*w);		m[2][1] = 2.f*(y*z + x*w);		m[2][2] = 1.f - 2.f*(x*x + y*y);
+			m[0][3] = p[0]; m[1][3] = p[1]; m[2][3] = p[2];
+			update();
+		}
+		
+		// this = a * b
+		void compose(const WorldTransform& a, const WorldTransform& b) {
+			for (int r=0; r<3; r++) {
+				for (int c=0; c<4; c++) {
+					m[r][c] = a.m[r][0]*b.m[0][c] + a.m[r][1]*b.m[1][c] + a.m[r][2]*b.m[2][c] + (c == 3 ? a.m[r][3] : 0.f);
+				}
+			}
+			update();
+		}
+		
+		// derive the scale & rotation quaternion of the linear part
+		void update() {
+			const float det = m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+				- m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+				+ m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+			scale = powf(fabsf(det), 1.f/3.f);
+			const float inv = scale > 0.f ? 1.f/scale : 0.f;
+			float r[3][3];
+			for (int i=0; i<3; i++) for (int j=0; j<3; j++) r[i][j] = m[i][j] * inv;
+			const float trace = r[0][0] + r[1][1] + r[2][2];
+			if (trace > 0.f) {
+				const float s = sqrtf(trace + 1.f) * 2.f;
+				q[3] = 0.25f * s; q[0] = (r[2][1] - r[1][2]) / s; q[1] = (r[0][2] - r[2][0]) / s; q[2] = (r[1][0] - r[0][1]) / s;
+			} else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+				const float s = sqrtf(1.f + r[0][0] - r[1][1] - r[2][2]) * 2.f;
+				q[3] = (r[2][1] - r[1][2]) / s; q[0] = 0.25f * s; q[1] = (r[0][1] + r[1][0]) / s; q[2] = (r[0][2] + r[2][0]) / s;
+			} else if (r[1][1] > r[2][2]) {
+				const float s = sqrtf(1.f + r[1][1] - r[0][0] - r[2][2]) * 2.f;
+				q[3] = (r[0][2] - r[2][0]) / s; q[0] = (r[0][1] + r[1][0]) / s; q[1] = 0.25f * s; q[2] = (r[1][2] + r[2][1]) / s;
+			} else {
+				const float s = sqrtf(1.f + r[2][2] - r[0][0] - r[1][1]) * 2.f;
+				q[3] = (r[1][0] - r[0][1]) / s; q[0] = (r[0][2] + r[2][0]) / s; q[1] = (r[1][2] + r[2][1]) / s; q[2] = 0.25f * s;
+			}
+		}
+		
+		// the axis conventions of @axes, as rotations of tracking space
+		static void axes(int convention, WorldTransform& out) {
+			out.identity();
+			if (convention == 1) {
+				// z up: x, -z, y
+				out.m[1][1] = 0.f; out.m[1][2] = -1.f;
+				out.m[2][1] = 1.f; out.m[2][2] = 0.f;
+			} else if (convention == 2) {
+				// head-mounted, facing away from the viewer, into head space (y up, -z forward): -x, -z, -y
+				out.m[0][0] = -1.f;
+				out.m[1][1] = 0.f; out.m[1][2] = -1.f;
+				out.m[2][1] = -1.f; out.m[2][2] = 0.f;
+			}
+			out.update();
+		}
+		
+		void apply(FrameData& f) const {
+			const int * points = pointOffsets();
+			const FieldOffsets& fields = fieldOffsets();
+			const float rs = scale > 0.f ? 1.f/scale : 0.f;
+			for (int i=0; i<f.numHands; i++) {
+				float * h = (float *)&f.hands[i];
+				for (int p=0; p<NUM_POINTS; p++) transformPoint(h + points[p], 1.f);
+				for (int p=0; p<NUM_VELOCITIES; p++) transformPoint(h + fields.velocities[p], 0.f);
+				for (int p=0; p<NUM_DIRECTIONS; p++) {
+					float * d = h + fields.directions[p];
+					transformPoint(d, 0.f);
+					d[0] *= rs; d[1] *= rs; d[2] *= rs;
+				}
+				for (int p=0; p<NUM_QUATS; p++) {
+					float * v = h + fields.quats[p];
+					quatMul(q, v, v);
+				}
+				for (int p=0; p<NUM_SIZES; p++) h[fields.sizes[p]] *= scale;
+			}
+			// the interaction box stays axis-aligned, so it grows to contain its rotated self:
+			float size[3];
+			for (int r=0; r<3; r++) size[r] = fabsf(m[r][0])*f.boxSize[0] + fabsf(m[r][1])*f.boxSize[1] + fabsf(m[r][2])*f.boxSize[2];
+			transformPoint(f.boxCenter, 1.f);
+			memcpy(f.boxSize, size, sizeof(size));
+		}
+		
+		inline void transformPoint(float * v, float w) const {
+			const float x = v[0], y = v[1], z = v[2];
+			v[0] = m[0][0]*x + m[0][1]*y + m[0][2]*z + m[0][3]*w;
+			v[1] = m[1][0]*x + m[1][1]*y + m[1][2]*z + m[1][3]*w;
+			v[2] = m[2][0]*x + m[2][1]*y + m[2][2]*z + m[2][3]*w;
+		}
+	};
+
+	// spherical interpolation from a to b, along the shorter arc
+	static void quatSlerp(const float * a, const float * b, float t, float * out) {
+		float d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+		const float sign = d < 0.f ? -1.f : 1.f;
+		d *= sign;
+		float wa = 1.f - t, wb = t;
+		if (d < 0.9995f) {
+			const float theta = acosf(d);
+			const float inv = 1.f / sinf(theta);
+			wa = sinf(wa * theta) * inv;
+			wb = sinf(wb * theta) * inv;
+		}
+		wb *= sign;
+		float m = 0.f;
+		for (int k=0; k<4; k++) {
+			out[k] = wa*a[k] + wb*b[k];
+			m += out[k]*out[k];
+		}
+		m = m > 0.f ? 1.f / sqrtf(m) : 0.f;
+		for (int k=0; k<4; k++) out[k] *= m;
+	}
+	
+	// @resample: one frame per tick of an internal clock at a fixed rate, interpolated at the
+	// sensor time matching the tick (so output doesn't depend on when frames are polled):
+	// positions linearly, quaternions by slerp, everything else from the nearer frame
+	// wall clock and sensor time are related by the smallest recent latency, and output
+	// lags 1.5 input intervals behind, so that there is normally a frame on either side
+	struct Resampler {
+	public:
+		enum { HISTORY = 4 };
+		
+		FrameData	frames[HISTORY];	// ring of the latest input frames
+		int			count, head;		// head: where the next frame goes
+		double		offset;		// wall clock minus sensor time, in microseconds
+		double		interval;	// between input frames, smoothed, in microseconds
+		double		arrived;	// wall clock time of the latest frame
+		
+		Resampler() : count(0), head(0), offset(0.), interval(0.), arrived(0.) {}
+		
+		const FrameData& at(int i) const {	// 0 = oldest
+			return frames[(head - count + i + HISTORY) % HISTORY];
+		}
+		
+		// now: wall clock in microseconds
+		void push(const FrameData& f, double now) {
+			if (count) {
+				const int64_t dt = f.timestamp - at(count-1).timestamp;
+				// start over after gaps and when the clock jumps back:
+				if (dt <= 0 || dt > 250000) {
+					count = 0;
+				} else {
+					interval = (count == 1) ? (double)dt : interval + (dt - interval) * 0.1;
+				}
+			}
+			// the smallest latency seen, drifting up slowly in case the clocks do:
+			const double o = now - (double)f.timestamp;
+			if (!count || o < offset) {
+				offset = o;
+			} else {
+				offset += (o - offset) * 0.01;
+			}
+			frames[head] = f;
+			head = (head + 1) % HISTORY;
+			if (count < HISTORY) count++;
+			arrived = now;
+		}
+		
+		// the frame at wall clock time now; false if there are no frames
+		bool interpolate(double now, FrameData& out) const {
+			if (!count) return false;
+			const int64_t t = (int64_t)(now - offset - 1.5 * interval);
+			int i = 0;
+			while (i < count-1 && at(i+1).timestamp <= t) i++;
+			const FrameData& a = at(i);
+			if (i == count-1 || t <= a.timestamp) {
+				out = a;	// hold the latest (or earliest) frame rather than extrapolate
+			} else {
+				const FrameData& b = at(i+1);
+				blend(a, b, (float)(t - a.timestamp) / (float)(b.timestamp - a.timestamp), out);
+			}
+			out.timestamp = t;
+			return true;
+		}
+		
+		static void blend(const FrameData& a, const FrameData& b, float u, FrameData& out) {
+			out = u < 0.5f ? a : b;
+			const int * offsets = pointOffsets();
+			for (int h=0; h<out.numHands; h++) {
+				HandData& o = out.hands[h];
+				const HandData * ha = NULL, * hb = NULL;
+				for (int j=0; j<a.numHands; j++) if (a.hands[j].id == o.id) ha = &a.hands[j];
+				for (int j=0; j<b.numHands; j++) if (b.hands[j].id == o.id) hb = &b.hands[j];
+				if (!ha || !hb) continue;
+				const float * pa = (const float *)ha, * pb = (const float *)hb;
+				float * po = (float *)&o;
+				for (int p=0; p<NUM_POINTS; p++) {
+					const int k = offsets[p];
+					for (int c=0; c<3; c++) po[k+c] = pa[k+c] + (pb[k+c] - pa[k+c]) * u;
+				}
+				quatSlerp(ha->palmQuat, hb->palmQuat, u, o.palmQuat);
+				quatSlerp(ha->armQuat, hb->armQuat, u, o.armQuat);
+				for (int f=0; f<5; f++) {
+					for (int bone=0; bone<4; bone++) {
+						quatSlerp(ha->fingers[f].bones[bone].quat, hb->fingers[f].bones[bone].quat, u, o.fingers[f].bones[bone].quat);
+					}
+				}
+			}
+		}
+	};
+	
+	// rolling movement statistics of every joint over the last `window` frames (@motion <frames>),
+	// per left/right hand; the sums are updated as samples enter and leave a ring buffer,
+	// and recomputed from the ring once per lap so that float error can't build up
+	// (joints are the innermost, contiguous dimension so that the loops vectorize)
+	struct MotionStats {
+	public:
+		// per joint: speed mean & variance, jerk mean & variance, path length,
+		// kinetic energy per unit mass (mean of speed^2 / 2), volume of the bounding box
+		enum { NUM_FEATURES = 7 };
+		enum { J = NUM_JOINTS };
+		
+		struct Sample {
+			float pos[3][J];
+			float speed[J], jerk[J], step[J];
+		};
+		
+		struct Side {
+			std::vector<Sample> ring;
+			int		head, count;
+			int32_t	id;			// -1: no hand
+			int		history;	// consecutive samples since the hand appeared
+			int64_t	time;
+			float	pos[3][J], vel[3][J], acc[3][J];
+			float	sumSpeed[J], sumSpeed2[J], sumJerk[J], sumJerk2[J], sumStep[J];
+		};
+		
+		Side	sides[2];
+		
+		MotionStats() {
+			for (int s=0; s<2; s++) sides[s].id = -1;
+		}
+		
+		static void reset(Side& s, int32_t id, int window) {
+			s.ring.resize(window);
+			s.head = s.count = 0;
+			s.id = id;
+			s.history = 0;
+			memset(s.vel, 0, sizeof(s.vel));
+			memset(s.acc, 0, sizeof(s.acc));
+			sum(s);
+		}
+		
+		// recompute the sums from the ring
+		static void sum(Side& s) {
+			for (int j=0; j<J; j++) s.sumSpeed[j] = s.sumSpeed2[j] = s.sumJerk[j] = s.sumJerk2[j] = s.sumStep[j] = 0.f;
+			for (int i=0; i<s.count; i++) {
+				const Sample& x = s.ring[i];
+				for (int j=0; j<J; j++) {
+					s.sumSpeed[j] += x.speed[j];
+					s.sumSpeed2[j] += x.speed[j]*x.speed[j];
+					s.sumJerk[j] += x.jerk[j];
+					s.sumJerk2[j] += x.jerk[j]*x.jerk[j];
+					s.sumStep[j] += x.step[j];
+				}
+			}
+		}
+		
+		void clear(int side) {
+			sides[side].id = -1;
+		}
+		
+		void update(int side, const HandData& h, int64_t timestamp, int window) {
+			Side& s = sides[side];
+			if (s.id != h.id || (int)s.ring.size() != window) reset(s, h.id, window);
+			
+			float p[3][J];
+			for (int j=0; j<J; j++) {
+				const float * v = jointPosition(h, j);
+				p[0][j] = v[0]; p[1][j] = v[1]; p[2][j] = v[2];
+			}
+			if (s.history > 0) {
+				const float dt = (timestamp - s.time) * 0.000001f;
+				if (dt <= 0.f) return;
+				const float inv = 1.f / dt;
+				
+				Sample& x = s.ring[s.head];
+				if (s.count == window) {
+					// the oldest sample leaves the window:
+					for (int j=0; j<J; j++) {
+						s.sumSpeed[j] -= x.speed[j];
+						s.sumSpeed2[j] -= x.speed[j]*x.speed[j];
+						s.sumJerk[j] -= x.jerk[j];
+						s.sumJerk2[j] -= x.jerk[j]*x.jerk[j];
+						s.sumStep[j] -= x.step[j];
+					}
+				}
+				
+				const float hasAcc = s.history >= 2 ? 1.f : 0.f;
+				const float hasJerk = s.history >= 3 ? 1.f : 0.f;
+				for (int j=0; j<J; j++) {
+					float step2 = 0.f, jerk2 = 0.f;
+					for (int k=0; k<3; k++) {
+						const float d = p[k][j] - s.pos[k][j];
+						const float v = d * inv;
+						const float a = (v - s.vel[k][j]) * inv * hasAcc;
+						const float jk = (a - s.acc[k][j]) * inv * hasJerk;
+						step2 += d*d;
+						jerk2 += jk*jk;
+						s.vel[k][j] = v;
+						s.acc[k][j] = a;
+					}
+					x.step[j] = sqrtf(step2);
+					x.speed[j] = x.step[j] * inv;
+					x.jerk[j] = sqrtf(jerk2);
+					s.sumSpeed[j] += x.speed[j];
+					s.sumSpeed2[j] += x.speed[j]*x.speed[j];
+					s.sumJerk[j] += x.jerk[j];
+					s.sumJerk2[j] += x.jerk[j]*x.jerk[j];
+					s.sumStep[j] += x.step[j];
+				}
+				memcpy(x.pos, p, sizeof(p));
+				
+				if (s.count < window) s.count++;
+				if (++s.head == window) {
+					s.head = 0;
+					sum(s);
+				}
+			}
+			memcpy(s.pos, p, sizeof(p));
+			s.time = timestamp;
+			s.history++;
+		}
+		
+		// NUM_FEATURES values per joint, joint by joint; false if there are no samples yet
+		bool features(int side, float * out) const {
+			const Side& s = sides[side];
+			if (s.id < 0 || s.count == 0) return false;
+			const float n = 1.f / s.count;
+			
+			float lo[3][J], hi[3][J];
+			memcpy(lo, s.ring[0].pos, sizeof(lo));
+			memcpy(hi, s.ring[0].pos, sizeof(hi));
+			for (int i=1; i<s.count; i++) {
+				const Sample& x = s.ring[i];
+				for (int k=0; k<3; k++) {
+					for (int j=0; j<J; j++) {
+						lo[k][j] = std::min(lo[k][j], x.pos[k][j]);
+						hi[k][j] = std::max(hi[k][j], x.pos[k][j]);
+					}
+				}
+			}
+			
+			for (int j=0; j<J; j++, out += NUM_FEATURES) {
+				const float speed = s.sumSpeed[j] * n;
+				const float speed2 = s.sumSpeed2[j] * n;
+				const float jerk = s.sumJerk[j] * n;
+				out[0] = speed;
+				out[1] = std::max(0.f, speed2 - speed*speed);
+				out[2] = jerk;
+				out[3] = std::max(0.f, s.sumJerk2[j] * n - jerk*jerk);
+				out[4] = s.sumStep[j];
+				out[5] = 0.5f * speed2;
+				out[6] = (hi[0][j]-lo[0][j]) * (hi[1][j]-lo[1][j]) * (hi[2][j]-lo[2][j]);
+			}
+			return true;
+		}
+	};
+	
+	// a fingertip stroke (@strokes): the tip path is resampled into control points at equal
+	// arc length, and a Catmull-Rom spline through them is extended one segment at a time as
+	// control points arrive (with equal spacing, the uniform parameterization doesn't overshoot)
+	struct StrokeBuilder {
+	public:
+		enum { MAX_VERTICES = 65536 };
+		
+		std::vector<float> controls;	// xyz
+		std::vector<float> vertices;	// xyz, the spline up to the second-to-last control point
+		float	tip[3];
+		float	travelled;	// along the path since the last control point
+		float	spacing;
+		int		subdivisions;
+		
+		StrokeBuilder() : travelled(0.f), spacing(0.005f), subdivisions(4) {}
+		
+		void begin(const float * p) {
+			controls.assign(p, p+3);
+			vertices.clear();
+			memcpy(tip, p, sizeof(tip));
+			travelled = 0.f;
+		}
+		
+		void add(const float * p) {
+			const float d[3] = { p[0]-tip[0], p[1]-tip[1], p[2]-tip[2] };
+			const float len = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+			if (len <= 0.f) return;
+			float t = spacing - travelled;
+			for (; t <= len; t += spacing) {
+				const float q[3] = { tip[0] + d[0]*(t/len), tip[1] + d[1]*(t/len), tip[2] + d[2]*(t/len) };
+				control(q);
+			}
+			travelled = len - (t - spacing);
+			memcpy(tip, p, sizeof(tip));
+		}
+		
+		// the final segment ends at the last control point, which is moved to the tip
+		void end() {
+			const size_t n = controls.size()/3;
+			if (n > 1) memcpy(&controls[(n-1)*3], tip, sizeof(tip));
+			else controls.insert(controls.end(), tip, tip+3);
+			const size_t m = controls.size()/3;
+			segment(m-2, m-1);
+			vertices.insert(vertices.end(), tip, tip+3);
+		}
+		
+		void control(const float * q) {
+			if (vertices.size()/3 + subdivisions > MAX_VERTICES) return;
+			controls.insert(controls.end(), q, q+3);
+			const size_t n = controls.size()/3;
+			if (n >= 3) segment(n-3, n-2);
+		}
+		
+		// append the spline from control a to b = a+1 (excluding b)
+		void segment(size_t a, size_t b) {
+			const size_t n = controls.size()/3;
+			const float * p0 = &controls[(a ? a-1 : a)*3];
+			const float * p1 = &controls[a*3];
+			const float * p2 = &controls[b*3];
+			const float * p3 = &controls[(b+1 < n ? b+1 : b)*3];
+			for (int i=0; i<subdivisions; i++) {
+				const float t = (float)i / subdivisions, t2 = t*t, t3 = t2*t;
+				for (int k=0; k<3; k++) {
+					vertices.push_back(0.5f * (2.f*p1[k] + (p2[k] - p0[k])*t
+						+ (2.f*p0[k] - 5.f*p1[k] + 4.f*p2[k] - p3[k])*t2
+						+ (3.f*p1[k] - p0[k] - 3.f*p2[k] + p3[k])*t3));
+				}
+			}
+		}
+		
+		// vertices so far, then straight to the controls not yet splined and the tip
+		size_t count() const {
+			const size_t n = controls.size()/3;
+			return vertices.size()/3 + (n >= 3 ? 2 : n) + 1;
+		}
+		
+		void snapshot(float * out) const {
+			const size_t n = controls.size()/3;
+			const size_t first = n >= 3 ? n-2 : 0;
+			if (vertices.size()) memcpy(out, &vertices[0], vertices.size()*sizeof(float));
+			out += vertices.size();
+			memcpy(out, &controls[first*3], (n-first)*3*sizeof(float));
+			out += (n-first)*3;
+			memcpy(out, tip, sizeof(tip));
+		}
+	};
+	
+	// skeleton-constraint outlier rejection (@constrain), per tracked hand (one left, one right):
+	// bone lengths are learned from confident frames, and each finger bone is checked, base to tip,
+	// against its learned length, the bend from its parent bone and a speed bound that tightens
+	// as confidence drops; with repair, a bad bone takes its last good vector (and rotation)
+	// and the rest of the finger is moved to stay attached
+	// the palm is checked against the speed bound too (with repair, a jumping hand is moved back),
+	// and a hand whose left/right label flips keeps its state and, with repair, its old label
+	// only accepted values are remembered, so an outlier is never the reference for the next frame
+	struct SkeletonConstraints {
+	public:
+		enum { NUM_BONES = 20, MIN_SAMPLES = 30, MAX_SAMPLES = 200 };
+		enum { MAX_REJECTED = 5 };	// consecutive frames, after which a bone (or palm, or label) is believed again
+		enum { SIDE_FLIPPED = -1 };	// in bad: the hand's left/right label
+		enum { MAX_BAD = NUM_BONES + 2 };
+		
+		struct Side {
+			float	length[NUM_BONES];	// learned
+			float	samples[NUM_BONES];
+			int		rejected[NUM_BONES];
+			int		palmRejected, flipRejected;
+			int32_t	id;					// of the last hand checked, or -1
+			int64_t	time;
+			float	palm[3];				// last accepted palm position
+			float	joints[NUM_BONES][3];	// last accepted nextJoint per bone
+			float	vectors[NUM_BONES][3];	// last accepted prevJoint -> nextJoint
+			float	quats[NUM_BONES][4];
+		};
+		
+		Side	sides[2];
+		float	tolerance;		// relative length error
+		float	maxSpeed;		// meters per second, at full confidence
+		float	minBend;		// cosine of the largest bend between consecutive bones
+		
+		SkeletonConstraints() : tolerance(0.25f), maxSpeed(4.f), minBend(-0.5f) {
+			reset();
+		}
+		
+		void reset() {
+			for (int s=0; s<2; s++) {
+				for (int i=0; i<NUM_BONES; i++) {
+					sides[s].length[i] = sides[s].samples[i] = 0.f;
+					sides[s].rejected[i] = 0;
+				}
+				sides[s].palmRejected = sides[s].flipRejected = 0;
+				sides[s].id = -1;
+			}
+		}
+		
+		void lost(int side) {
+			sides[side].id = -1;
+		}
+		
+		// the state a hand is tracked with: the side that last checked its id,
+		// else (-1) it is new and takes the side of its label
+		int slot(const HandData& h) const {
+			for (int s=0; s<2; s++) if (sides[s].id == h.id) return s;
+			return -1;
+		}
+		
+		static bool tooFast(const float * a, const float * b, float limit) {
+			const float d[3] = { a[0]-b[0], a[1]-b[1], a[2]-b[2] };
+			return d[0]*d[0] + d[1]*d[1] + d[2]*d[2] > limit*limit;
+		}
+		
+		// check (and repair) a hand with the state of a side;
+		// returns the number of bad joints, listed in bad (joint indices, see jointName, or SIDE_FLIPPED)
+		int apply(HandData& h, int side, int64_t timestamp, bool repair, int * bad) {
+			Side& s = sides[side];
+			bool tracked = s.id == h.id && timestamp > s.time;
+			const float dt = tracked ? (timestamp - s.time) * 0.000001f : 0.f;
+			const float limit = maxSpeed * (0.25f + 0.75f * h.confidence) * dt;
+			int count = 0;
+			
+			// the same hand, with the other label:
+			if (tracked && h.isRight != side) {
+				if (s.flipRejected < MAX_REJECTED) {
+					bad[count++] = SIDE_FLIPPED;
+					s.flipRejected++;
+					if (repair) h.isRight = side;
+				} else {
+					// believed: it starts over as a new hand of the other side
+					s.flipRejected = 0;
+					s.id = -1;
+					return 0;
+				}
+			} else {
+				s.flipRejected = 0;
+			}
+			
+			// the whole hand jumping:
+			float jump[3] = { 0.f, 0.f, 0.f };	// undoes it, for comparing the fingers
+			bool store = true;
+			if (tracked && tooFast(h.palmPosition, s.palm, limit)) {
+				if (s.palmRejected < MAX_REJECTED) {
+					bad[count++] = JOINT_PALM;
+					s.palmRejected++;
+					for (int k=0; k<3; k++) jump[k] = s.palm[k] - h.palmPosition[k];
+					if (repair) {
+						const int * offsets = pointOffsets();
+						float * base = (float *)&h;
+						for (int p=0; p<NUM_POINTS; p++) {
+							float * v = base + offsets[p];
+							v[0] += jump[0]; v[1] += jump[1]; v[2] += jump[2];
+						}
+						jump[0] = jump[1] = jump[2] = 0.f;
+					} else {
+						store = false;		// the state stays where the hand was
+					}
+				} else {
+					s.palmRejected = 0;
+					tracked = false;		// believed: everything starts over from here
+				}
+			} else {
+				s.palmRejected = 0;
+			}
+			if (store) memcpy(s.palm, h.palmPosition, sizeof(s.palm));
+			
+			for (int f=0; f<5; f++) {
+				FingerData& finger = h.fingers[f];
+				float shift[3] = { 0.f, 0.f, 0.f };	// of the parent's end, by repairs
+				float parent[3];					// the parent bone's vector
+				float parentLen = 0.f;
+				for (int b=0; b<4; b++) {
+					const int i = f*4 + b;
+					BoneData& bone = finger.bones[b];
+					float v[3], len2 = 0.f;
+					for (int k=0; k<3; k++) {
+						bone.prevJoint[k] += shift[k];
+						bone.nextJoint[k] += shift[k];
+						v[k] = bone.nextJoint[k] - bone.prevJoint[k];
+						len2 += v[k]*v[k];
+					}
+					const float len = sqrtf(len2);
+					
+					bool wrong = false;
+					if (s.samples[i] >= MIN_SAMPLES) {
+						wrong = fabsf(len - s.length[i]) > std::max(tolerance * s.length[i], 0.005f);
+					}
+					if (b && len > 0.001f && parentLen > 0.001f) {
+						const float c = (v[0]*parent[0] + v[1]*parent[1] + v[2]*parent[2]) / (len * parentLen);
+						wrong = wrong || c < minBend;
+					}
+					if (tracked) {
+						const float p[3] = { bone.nextJoint[0]+jump[0], bone.nextJoint[1]+jump[1], bone.nextJoint[2]+jump[2] };
+						wrong = wrong || tooFast(p, s.joints[i], limit);
+					}
+					
+					if (wrong && s.rejected[i] < MAX_REJECTED) {
+						bad[count++] = JOINT_FINGERS + f*5 + b + 1;
+						s.rejected[i]++;
+					} else {
+						if (wrong) s.samples[i] = 0.f;	// believed again: relearn its length
+						wrong = false;
+						s.rejected[i] = 0;
+						if (h.confidence > 0.5f && len > 0.f) {
+							// learn, ever more slowly:
+							if (s.samples[i] < MAX_SAMPLES) s.samples[i] += 1.f;
+							s.length[i] += (len - s.length[i]) / s.samples[i];
+						}
+					}
+					
+					if (wrong && repair && tracked) {
+						float len2 = 0.f;
+						for (int k=0; k<3; k++) {
+							const float next = bone.prevJoint[k] + s.vectors[i][k];
+							shift[k] += next - bone.nextJoint[k];
+							bone.nextJoint[k] = next;
+							v[k] = s.vectors[i][k];
+							len2 += v[k]*v[k];
+						}
+						memcpy(bone.quat, s.quats[i], sizeof(bone.quat));
+						bone.length = sqrtf(len2);
+						const float inv = bone.length > 0.f ? 1.f / bone.length : 0.f;
+						for (int k=0; k<3; k++) {
+							bone.center[k] = bone.prevJoint[k] + 0.5f * v[k];
+							bone.direction[k] = v[k] * inv;
+						}
+					} else if (shift[0] != 0.f || shift[1] != 0.f || shift[2] != 0.f) {
+						for (int k=0; k<3; k++) bone.center[k] += shift[k];
+					}
+					
+					// remember accepted bones (and everything about a new hand, there being nothing better):
+					if (store && (!wrong || !tracked)) {
+						memcpy(s.joints[i], bone.nextJoint, sizeof(s.joints[i]));
+						memcpy(s.vectors[i], v, sizeof(v));
+						memcpy(s.quats[i], bone.quat, sizeof(s.quats[i]));
+					}
+					memcpy(parent, v, sizeof(v));
+					parentLen = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+				}
+				if (repair) {
+					for (int k=0; k<3; k++) {
+						finger.tipPosition[k] = finger.bones[3].nextJoint[k];
+						finger.stabilizedTipPosition[k] += shift[k];
+					}
+				}
+			}
+			s.id = h.id;
+			s.time = timestamp;
+			return count;
+		}
+	};
+	
+	/*
+		a fixed-length feature vector per frame for machine learning (@features <groups...>):
+		a left-hand slot then a right-hand slot, each with the groups in the order given,
+		all zero when that hand is missing; feature_names lists what each value is
+		
+		groups (number of values): present (1), confidence (1), grab (1), pinch (1), extended (5),
+		tips (15), joints (81), quats (80), velocity (18), pinch_distances (4), palm (7)
+		
+		except for palm (position & quat in tracking/world space), everything is hand-relative:
+		positions & velocities in the palm's frame (origin at the palm, rotated by its inverse
+		quat) and in palm widths, bone quats relative to the palm
+	*/
+	struct FeatureVector {
+	public:
+		enum { PRESENT, CONFIDENCE, GRAB, PINCH, EXTENDED, TIPS, JOINTS, QUATS, VELOCITY, PINCH_DISTANCES, PALM, NUM_GROUPS };
+		
+		static const char * groupName(int g) {
+			static const char * names[NUM_GROUPS] = { "present", "confidence", "grab", "pinch", "extended",
+				"tips", "joints", "quats", "velocity", "pinch_distances", "palm" };
+			return names[g];
+		}
+		
+		static int groupSize(int g) {
+			static const int sizes[NUM_GROUPS] = { 1, 1, 1, 1, 5, 5*3, (NUM_JOINTS-1)*3, 20*4, 6*3, 4, 7 };
+			return sizes[g];
+		}
+		
+		static int group(t_symbol * name) {
+			for (int g=0; g<NUM_GROUPS; g++) if (!strcmp(name->s_name, groupName(g))) return g;
+			return -1;
+		}
+		
+		// a point or vector in the palm's frame, in palm widths
+		struct PalmFrame {
+			float origin[3], inverse[4], scale;
+			
+			PalmFrame(const HandData& h) {
+				memcpy(origin, h.palmPosition, sizeof(origin));
+				quatConj(h.palmQuat, inverse);
+				scale = h.palmWidth > 0.f ? 1.f / h.palmWidth : 1.f;
+			}
+			
+			float * point(const float * p, float * out) const {
+				const float d[3] = { p[0]-origin[0], p[1]-origin[1], p[2]-origin[2] };
+				return vector(d, out);
+			}
+			
+			float * vector(const float * v, float * out) const {
+				quatRotate(inverse, v, out);
+				out[0] *= scale; out[1] *= scale; out[2] *= scale;
+				return out + 3;
+			}
+		};
+		
+		// write a group's values for a hand (present), returns the end
+		static float * fill(int g, const HandData& h, const PalmFrame& frame, float * out) {
+			switch (g) {
+				case PRESENT: *out++ = 1.f; break;
+				case CONFIDENCE: *out++ = h.confidence; break;
+				case GRAB: *out++ = h.grabStrength; break;
+				case PINCH: *out++ = h.pinchStrength; break;
+				case EXTENDED: for (int f=0; f<5; f++) *out++ = (float)h.fingers[f].extended; break;
+				case TIPS: for (int f=0; f<5; f++) out = frame.point(h.fingers[f].tipPosition, out); break;
+				case JOINTS: for (int j=1; j<NUM_JOINTS; j++) out = frame.point(jointPosition(h, j), out); break;
+				case QUATS:
+					for (int f=0; f<5; f++) {
+						for (int b=0; b<4; b++, out += 4) quatMul(frame.inverse, h.fingers[f].bones[b].quat, out);
+					}
+					break;
+				case VELOCITY:
+					out = frame.vector(h.palmVelocity, out);
+					for (int f=0; f<5; f++) out = frame.vector(h.fingers[f].tipVelocity, out);
+					break;
+				case PINCH_DISTANCES:
+					for (int f=1; f<5; f++) {
+						const float * a = h.fingers[0].tipPosition, * b = h.fingers[f].tipPosition;
+						const float d[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+						*out++ = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]) * frame.scale;
+					}
+					break;
+				case PALM:
+					memcpy(out, h.palmPosition, sizeof(float)*3);
+					memcpy(out+3, h.palmQuat, sizeof(float)*4);
+					out += 7;
+					break;
+				default: break;
+			}
+			return out;
+		}
+		
+		// the names of a group's values, in the same order as fill()
+		static void names(int g, const char * side, std::vector<std::string>& out) {
+			static const char * fingers[5] = { "thumb", "index", "middle", "ring", "pinky" };
+			static const char * bones[4] = { "metacarpal", "proximal", "intermediate", "distal" };
+			static const char * axes[4] = { "x", "y", "z", "w" };
+			char name[128];
+			switch (g) {
+				case EXTENDED:
+					for (int f=0; f<5; f++) {
+						snprintf(name, sizeof(name), "%s_extended_%s", side, fingers[f]);
+						out.push_back(name);
+					}
+					break;
+				case TIPS: case JOINTS: case VELOCITY: {
+					const int n = (g == JOINTS) ? NUM_JOINTS-1 : (g == TIPS) ? 5 : 6;
+					for (int i=0; i<n; i++) {
+						const char * what = (g == JOINTS) ? jointName(i+1) : (g == TIPS) ? fingers[i] : (i ? fingers[i-1] : "palm");
+						for (int k=0; k<3; k++) {
+							snprintf(name, sizeof(name), "%s_%s_%s_%s", side, g == VELOCITY ? "velocity" : g == TIPS ? "tip" : "joint", what, axes[k]);
+							out.push_back(name);
+						}
+					}
+				} break;
+				case QUATS:
+					for (int f=0; f<5; f++) {
+						for (int b=0; b<4; b++) {
+							for (int k=0; k<4; k++) {
+								snprintf(name, sizeof(name), "%s_quat_%s_%s_%s", side, fingers[f], bones[b], axes[k]);
+								out.push_back(name);
+							}
+						}
+					}
+					break;
+				case PINCH_DISTANCES:
+					for (int f=1; f<5; f++) {
+						snprintf(name, sizeof(name), "%s_pinch_distance_%s", side, fingers[f]);
+						out.push_back(name);
+					}
+					break;
+				case PALM: {
+					static const char * palm[7] = { "x", "y", "z", "qx", "qy", "qz", "qw" };
+					for (int k=0; k<7; k++) {
+						snprintf(name, sizeof(name), "%s_palm_%s", side, palm[k]);
+						out.push_back(name);
+					}
+				} break;
+				default:
+					snprintf(name, sizeof(name), "%s_%s", side, groupName(g));
+					out.push_back(name);
+					break;
+			}
+		}
+	};
+	
+	// parent-relative transforms for driving rigged hands (@retarget)
+	// node 0 is the palm (world position & rotation), then metacarpal..distal for thumb..pinky;
+	// each bone's position is its base joint and its rotation is relative to its parent
+	// (the palm, for metacarpals), both expressed in the parent's frame
+	// rotations are then taken relative to a rest pose: out = inverse(rest) * local
+	struct Retargeter {
+	public:
+		enum { NUM_NODES = 21 };
+		
+		float rest[2][NUM_NODES][4];	// per left/right hand
+		
+		Retargeter() { clear(); }
+		
+		void clear() {
+			for (int s=0; s<2; s++) {
+				for (int i=0; i<NUM_NODES; i++) {
+					rest[s][i][0] = rest[s][i][1] = rest[s][i][2] = 0.f;
+					rest[s][i][3] = 1.f;
+				}
+			}
+		}
+		
+		static int parent(int node) {
+			return (node == 0 || (node-1) % 4 == 0) ? 0 : node-1;
+		}
+		
+		// local rotations & offsets of all nodes, before the rest pose
+		static void local(const HandData& h, float (*quats)[4], float (*offsets)[3]) {
+			const float * world[NUM_NODES];
+			const float * origin[NUM_NODES];
+			world[0] = h.palmQuat;
+			origin[0] = h.palmPosition;
+			for (int f=0; f<5; f++) {
+				for (int b=0; b<4; b++) {
+					world[1 + f*4 + b] = h.fingers[f].bones[b].quat;
+					origin[1 + f*4 + b] = h.fingers[f].bones[b].prevJoint;
+				}
+			}
+			memcpy(quats[0], world[0], sizeof(float)*4);
+			memcpy(offsets[0], origin[0], sizeof(float)*3);
+			for (int i=1; i<NUM_NODES; i++) {
+				const int p = parent(i);
+				float inv[4];
+				quatConj(world[p], inv);
+				quatMul(inv, world[i], quats[i]);
+				const float d[3] = { origin[i][0] - origin[p][0], origin[i][1] - origin[p][1], origin[i][2] - origin[p][2] };
+				quatRotate(inv, d, offsets[i]);
+			}
+		}
+		
+		void capture(const HandData& h) {
+			float offsets[NUM_NODES][3];
+			local(h, rest[h.isRight ? 1 : 0], offsets);
+		}
+		
+		void compute(const HandData& h, float (*quats)[4], float (*offsets)[3]) const {
+			local(h, quats, offsets);
+			const float (*r)[4] = rest[h.isRight ? 1 : 0];
+			for (int i=0; i<NUM_NODES; i++) {
+				float inv[4];
+				quatConj(r[i], inv);
+				quatMul(inv, quats[i], quats[i]);
+			}
+		}
+	};
+
+	// spatial trigger zones (spheres & boxes), indexed by a uniform grid over their bounds
+	// so that each joint is only tested against the zones that share its cell
+	struct ZoneSet {
+	public:
+		enum { MAX_DIM = 64 };
+		
+		struct Zone {
+			t_symbol *	name;
+			int			sphere;
+			float		min[3], max[3];	// bounds (of the sphere too)
+			float		center[3], radius2;
+		};
+		
+		// a joint of a hand inside a zone
+		struct Entry {
+			int32_t hand;
+			int16_t joint, zone;
+			int32_t right;		// not part of the ordering
+			bool operator<(const Entry& e) const {
+				if (hand != e.hand) return hand < e.hand;
+				if (joint != e.joint) return joint < e.joint;
+				return zone < e.zone;
+			}
+			bool operator==(const Entry& e) const { return hand == e.hand && joint == e.joint && zone == e.zone; }
+		};
+		
+		std::vector<Zone> zones;
+		float		origin[3], cellSize[3];
+		int			dim[3];
+		std::vector<int> cellStart;		// per cell, into cellZones (one extra at the end)
+		std::vector<int16_t> cellZones;
+		float		cell;				// requested cell size
+		
+		std::vector<Entry> inside, previous;	// current & last frame, sorted
+		std::vector<std::pair<Entry, t_symbol *> > exits;	// from zones removed since the last frame
+		
+		ZoneSet() : cell(0.05f) { build(); }
+		
+		int find(t_symbol * name) const {
+			for (size_t i=0; i<zones.size(); i++) if (zones[i].name == name) return (int)i;
+			return -1;
+		}
+		
+		void setSphere(t_symbol * name, const float * c, float r) {
+			Zone z;
+			z.name = name;
+			z.sphere = 1;
+			for (int k=0; k<3; k++) {
+				z.center[k] = c[k];
+				z.min[k] = c[k] - r;
+				z.max[k] = c[k] + r;
+			}
+			z.radius2 = r*r;
+			set(z);
+		}
+		
+		void setBox(t_symbol * name, const float * a, const float * b) {
+			Zone z;
+			z.name = name;
+			z.sphere = 0;
+			for (int k=0; k<3; k++) {
+				z.min[k] = std::min(a[k], b[k]);
+				z.max[k] = std::max(a[k], b[k]);
+				z.center[k] = 0.5f*(z.min[k] + z.max[k]);
+			}
+			z.radius2 = 0.f;
+			set(z);
+		}
+		
+		void set(const Zone& z) {
+			int i = find(z.name);
+			if (i < 0) zones.push_back(z); else zones[i] = z;
+			build();
+		}
+		
+		// joints inside a removed zone exit it on the next frame,
+		// and the other entries follow their zones to the new indices
+		// (zones that are moved or added keep their indices, so tracking carries on)
+		void remove(t_symbol * name) {
+			int i = find(name);
+			if (i < 0) return;
+			size_t w = 0;
+			for (size_t j=0; j<inside.size(); j++) {
+				Entry e = inside[j];
+				if (e.zone == i) {
+					exits.push_back(std::make_pair(e, name));
+					continue;
+				}
+				if (e.zone > i) e.zone--;	// keeps the order
+				inside[w++] = e;
+			}
+			inside.resize(w);
+			zones.erase(zones.begin() + i);
+			build();
+		}
+		
+		void clear() {
+			for (size_t j=0; j<inside.size(); j++) exits.push_back(std::make_pair(inside[j], zones[inside[j].zone].name));
+			inside.clear();
+			zones.clear();
+			build();
+		}
+		
+		// rebuild the grid (zone indices are unchanged)
+		void build() {
+			for (int k=0; k<3; k++) {
+				origin[k] = 0.f;
+				cellSize[k] = 1.f;
+				dim[k] = 1;
+			}
+			if (zones.size()) {
+				float lo[3], hi[3];
+				for (int k=0; k<3; k++) {
+					lo[k] = zones[0].min[k];
+					hi[k] = zones[0].max[k];
+				}
+				for (size_t i=1; i<zones.size(); i++) {
+					for (int k=0; k<3; k++) {
+						lo[k] = std::min(lo[k], zones[i].min[k]);
+						hi[k] = std::max(hi[k], zones[i].max[k]);
+					}
+				}
+				for (int k=0; k<3; k++) {
+					const float extent = std::max(hi[k] - lo[k], 1e-6f);
+					dim[k] = std::max(1, std::min((int)MAX_DIM, (int)ceilf(extent / std::max(cell, 1e-3f))));
+					origin[k] = lo[k];
+					cellSize[k] = extent / dim[k];
+				}
+			}
+			const int cells = dim[0]*dim[1]*dim[2];
+			std::vector<int> counts(cells + 1, 0);
+			for (int pass=0; pass<2; pass++) {
+				if (pass) {
+					cellStart.assign(cells + 1, 0);
+					for (int c=0; c<cells; c++) cellStart[c+1] = cellStart[c] + counts[c];
+					cellZones.resize(cellStart[cells]);
+					std::fill(counts.begin(), counts.end(), 0);
+				}
+				for (size_t i=0; i<zones.size(); i++) {
+					int c0[3], c1[3];
+					cellRange(zones[i].min, c0);
+					cellRange(zones[i].max, c1);
+					for (int z=c0[2]; z<=c1[2]; z++) {
+						for (int y=c0[1]; y<=c1[1]; y++) {
+							for (int x=c0[0]; x<=c1[0]; x++) {
+								const int c = (z*dim[1] + y)*dim[0] + x;
+								if (pass) cellZones[cellStart[c] + counts[c]] = (int16_t)i;
+								counts[c]++;
+							}
+						}
+					}
+				}
+			}
+		}
+		
+		void cellRange(const float * p, int * c) const {
+			for (int k=0; k<3; k++) {
+				int v = (int)floorf((p[k] - origin[k]) / cellSize[k]);
+				c[k] = v < 0 ? 0 : v >= dim[k] ? dim[k]-1 : v;
+			}
+		}
+		
+		static bool contains(const Zone& z, const float * p) {
+			if (z.sphere) {
+				const float dx = p[0]-z.center[0], dy = p[1]-z.center[1], dz = p[2]-z.center[2];
+				return dx*dx + dy*dy + dz*dz <= z.radius2;
+			}
+			return p[0] >= z.min[0] && p[0] <= z.max[0]
+				&& p[1] >= z.min[1] && p[1] <= z.max[1]
+				&& p[2] >= z.min[2] && p[2] <= z.max[2];
+		}
+		
+		// collect the zones containing a joint
+		void test(int32_t hand, bool right, int joint, const float * p) {
+			int c[3];
+			for (int k=0; k<3; k++) {
+				const float v = (p[k] - origin[k]) / cellSize[k];
+				if (v < 0.f || v >= dim[k]) return;	// outside every zone
+				c[k] = (int)v;
+			}
+			const int cellIndex = (c[2]*dim[1] + c[1])*dim[0] + c[0];
+			for (int i=cellStart[cellIndex]; i<cellStart[cellIndex+1]; i++) {
+				const int zi = cellZones[i];
+				if (contains(zones[zi], p)) {
+					Entry e = { hand, (int16_t)joint, (int16_t)zi, right };
+					inside.push_back(e);
+				}
+			}
+		}
+		
+		void beginFrame() {
+			previous.swap(inside);
+			inside.clear();
+		}
+		
+		void endFrame() {
+			std::sort(inside.begin(), inside.end());
+		}
+	};
+
+	/*
+		threshold & hysteresis rules over hand fields, compiled from a dictionary (rules <dict>):
+		{ <name> : { "field" : <field>, "above" | "below" : <threshold>,
+		             "release" : <threshold to turn off again, default: the same>,
+		             "for" : <ms the condition must hold before turning on, default 0>,
+		             "hand" : "left" | "right" | "any" (default) }, ... }
+		
+		fields: confidence, grabStrength, pinchStrength, palmWidth, sphereRadius, palmSpeed,
+		palmPosition.x (.y .z), palmVelocity.x, palmNormal.x, direction.x,
+		<finger>.extended, <finger>.touchZone, <finger>.touchDistance, <finger>.tipPosition.x, <finger>.tipVelocity.x
+		(finger: thumb, index, middle, ring, pinky), and for two hands: palmDistance (meters), palmAngle (degrees)
+		
+		events: rule <name> on|off <left|right|both> <value>
+	*/
+	struct RuleEngine {
+	public:
+		enum { SOURCE_FLOAT, SOURCE_INT, SOURCE_PALM_SPEED, SOURCE_PALM_DISTANCE, SOURCE_PALM_ANGLE };
+		enum { HAND_ANY, HAND_LEFT, HAND_RIGHT };
+		
+		struct Rule {
+			t_symbol *	name;
+			int			source;
+			int			offset;		// into HandData, in floats/int32s, for SOURCE_FLOAT/SOURCE_INT
+			int			hand;
+			int			below;		// on when the value is below the threshold (rather than above)
+			float		threshold, release;
+			int64_t		hold;		// microseconds
+			// state, per left/right (or [0] for two-hand rules):
+			int			active[2];
+			int64_t		since[2];	// when the condition started to hold, or -1
+			float		value[2];	// the last value
+		};
+		
+		std::vector<Rule> rules;
+		
+		static bool twoHanded(const Rule& r) {
+			return r.source == SOURCE_PALM_DISTANCE || r.source == SOURCE_PALM_ANGLE;
+		}
+		
+		// resolve a field name; returns false if unknown
+		static bool resolve(const char * field, Rule& r) {
+			static HandData h;
+			const char * base = (const char *)&h;
+			r.offset = 0;
+			r.source = SOURCE_FLOAT;
+			if (!strcmp(field, "palmSpeed")) { r.source = SOURCE_PALM_SPEED; return true; }
+			if (!strcmp(field, "palmDistance")) { r.source = SOURCE_PALM_DISTANCE; return true; }
+			if (!strcmp(field, "palmAngle")) { r.source = SOURCE_PALM_ANGLE; return true; }
+			
+			static const char * fingers[5] = { "thumb", "index", "middle", "ring", "pinky" };
+			const FingerData * finger = NULL;
+			const char * dot = strchr(field, '.');
+			for (int f=0; f<5 && dot; f++) {
+				if ((size_t)(dot - field) == strlen(fingers[f]) && !strncmp(field, fingers[f], dot - field)) {
+					finger = &h.fingers[f];
+					field = dot + 1;
+				}
+			}
+			
+			// optional vector component:
+			char name[64];
+			strncpy_zero(name, field, sizeof(name));
+			int axis = 0;
+			size_t len = strlen(name);
+			if (len > 2 && name[len-2] == '.' && name[len-1] >= 'x' && name[len-1] <= 'z') {
+				axis = name[len-1] - 'x';
+				name[len-2] = 0;
+			}
+			
+			const void * p = NULL;
+			if (finger) {
+				if (!strcmp(name, "extended")) { p = &finger->extended; r.source = SOURCE_INT; }
+				else if (!strcmp(name, "touchZone")) { p = &finger->touchZone; r.source = SOURCE_INT; }
+				else if (!strcmp(name, "touchDistance")) p = &finger->touchDistance;
+				else if (!strcmp(name, "tipPosition")) p = finger->tipPosition + axis;
+				else if (!strcmp(name, "tipVelocity")) p = finger->tipVelocity + axis;
+			} else {
+				if (!strcmp(name, "confidence")) p = &h.confidence;
+				else if (!strcmp(name, "grabStrength")) p = &h.grabStrength;
+				else if (!strcmp(name, "pinchStrength")) p = &h.pinchStrength;
+				else if (!strcmp(name, "palmWidth")) p = &h.palmWidth;
+				else if (!strcmp(name, "sphereRadius")) p = &h.sphereRadius;
+				else if (!strcmp(name, "palmPosition")) p = h.palmPosition + axis;
+				else if (!strcmp(name, "palmVelocity")) p = h.palmVelocity + axis;
+				else if (!strcmp(name, "palmNormal")) p = h.palmNormal + axis;
+				else if (!strcmp(name, "direction")) p = h.direction + axis;
+			}
+			if (!p) return false;
+			r.offset = (int)(((const char *)p - base) / 4);
+			return true;
+		}
+		
+		static float value(const Rule& r, const HandData& h) {
+			switch (r.source) {
+				case SOURCE_INT: return (float)((const int32_t *)&h)[r.offset];
+				case SOURCE_PALM_SPEED: {
+					const float * v = h.palmVelocity;
+					return sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+				}
+				default: return ((const float *)&h)[r.offset];
+			}
+		}
+		
+		static float value(const Rule& r, const HandData& a, const HandData& b) {
+			if (r.source == SOURCE_PALM_DISTANCE) {
+				const float dx = a.palmPosition[0]-b.palmPosition[0], dy = a.palmPosition[1]-b.palmPosition[1], dz = a.palmPosition[2]-b.palmPosition[2];
+				return sqrtf(dx*dx + dy*dy + dz*dz);
+			}
+			const float * n = a.palmNormal, * m = b.palmNormal;
+			float c = n[0]*m[0] + n[1]*m[1] + n[2]*m[2];
+			c = c < -1.f ? -1.f : c > 1.f ? 1.f : c;
+			return acosf(c) * 57.29577951f;
+		}
+		
+		// update a rule's state for one side; returns +1 (turned on), -1 (turned off) or 0
+		static int step(Rule& r, int side, bool present, float v, int64_t time) {
+			if (!present) {
+				r.since[side] = -1;
+				if (r.active[side]) { r.active[side] = 0; return -1; }
+				return 0;
+			}
+			if (r.active[side]) {
+				const bool released = r.below ? (v > r.release) : (v < r.release);
+				if (released) {
+					r.active[side] = 0;
+					r.since[side] = -1;
+					return -1;
+				}
+				return 0;
+			}
+			const bool on = r.below ? (v < r.threshold) : (v > r.threshold);
+			if (!on) {
+				r.since[side] = -1;
+				return 0;
+			}
+			if (r.since[side] < 0) r.since[side] = time;
+			if (time - r.since[side] >= r.hold) {
+				r.active[side] = 1;
+				return 1;
+			}
+			return 0;
+		}
+	};
+
+	// triangle mesh of the hands for jit.gl.mesh (@mesh 1):
+	// a tube around every bone, a sphere at every joint and a slab for the palm
+	// the topology depends only on the level of detail, so indices are written once per hand slot,
+	// and vertices are generated by offsetting precomputed unit circles & spheres,
+	// in plain loops over contiguous floats that the compiler can vectorize
+	struct HandMesh {
+	public:
+		enum { MAX_SEGMENTS = 16, PALM_POINTS = 7, NUM_SPHERES = 25, NUM_TUBES = 20 };
+		
+		int			lod, segments, rings;
+		float		circle_cos[MAX_SEGMENTS], circle_sin[MAX_SEGMENTS];
+		std::vector<float> sphere;	// unit sphere vertices (also the normals), xyz
+		int			sphereVertices, tubeVertices, palmVertices;
+		int			verticesPerHand, indicesPerHand;
+		
+		HandMesh() : lod(-1) { setLOD(2); }
+		
+		// lod 0..3: 6, 8, 12 or 16 segments around each tube & sphere
+		void setLOD(int l) {
+			static const int table[4] = { 6, 8, 12, 16 };
+			l = l < 0 ? 0 : l > 3 ? 3 : l;
+			if (l == lod) return;
+			lod = l;
+			const double pi = 3.14159265358979323846;
+			segments = table[lod];
+			rings = segments/2;
+			for (int k=0; k<segments; k++) {
+				const double a = 2. * pi * k / segments;
+				circle_cos[k] = (float)cos(a);
+				circle_sin[k] = (float)sin(a);
+			}
+			sphereVertices = (rings+1) * segments;
+			sphere.resize(sphereVertices * 3);
+			float * t = &sphere[0];
+			for (int i=0; i<=rings; i++) {
+				const double theta = pi * i / rings;
+				const float z = (float)cos(theta), r = (float)sin(theta);
+				for (int k=0; k<segments; k++) {
+					*t++ = r * circle_cos[k];
+					*t++ = r * circle_sin[k];
+					*t++ = z;
+				}
+			}
+			tubeVertices = 2 * segments;
+			palmVertices = 2*(PALM_POINTS+1) + 4*PALM_POINTS;
+			verticesPerHand = NUM_TUBES*tubeVertices + NUM_SPHERES*sphereVertices + palmVertices;
+			indicesPerHand = NUM_TUBES*6*segments + NUM_SPHERES*6*rings*segments + 12*PALM_POINTS;
+		}
+		
+		// triangle indices for the hand whose vertices start at base
+		void writeIndices(int32_t * out, int32_t base) const {
+			const int S = segments;
+			for (int b=0; b<NUM_TUBES; b++, base += tubeVertices) {
+				for (int k=0; k<S; k++) {
+					const int32_t a = base + k, c = base + (k+1)%S;
+					*out++ = a; *out++ = c; *out++ = c+S;
+					*out++ = a; *out++ = c+S; *out++ = a+S;
+				}
+			}
+			for (int j=0; j<NUM_SPHERES; j++, base += sphereVertices) {
+				for (int i=0; i<rings; i++) {
+					for (int k=0; k<S; k++) {
+						const int32_t a = base + i*S + k, b = base + i*S + (k+1)%S;
+						*out++ = a; *out++ = b+S; *out++ = b;
+						*out++ = a; *out++ = a+S; *out++ = b+S;
+					}
+				}
+			}
+			// palm: centre & outline on the palm side, the same on the back, then 4 vertices per side
+			const int N = PALM_POINTS;
+			const int32_t front = base, back = base + N+1, sides = base + 2*(N+1);
+			for (int i=0; i<N; i++) {
+				const int n = (i+1)%N;
+				*out++ = front; *out++ = front+1+i; *out++ = front+1+n;
+				*out++ = back; *out++ = back+1+n; *out++ = back+1+i;
+				const int32_t q = sides + 4*i;	// a+, a-, b-, b+
+				*out++ = q; *out++ = q+1; *out++ = q+2;
+				*out++ = q; *out++ = q+2; *out++ = q+3;
+			}
+		}
+		
+		static void normalize(float * v) {
+			const float len = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+			if (len > 0.f) { v[0] /= len; v[1] /= len; v[2] /= len; }
+		}
+		
+		static void cross(const float * a, const float * b, float * out) {
+			out[0] = a[1]*b[2] - a[2]*b[1];
+			out[1] = a[2]*b[0] - a[0]*b[2];
+			out[2] = a[0]*b[1] - a[1]*b[0];
+		}
+		
+		void tube(const float * p0, const float * p1, const float * dir, const float * hint, float radius, float *& pos, float *& nrm) const {
+			float u[3], v[3];
+			cross(dir, hint, u);
+			if (u[0]*u[0] + u[1]*u[1] + u[2]*u[2] < 1e-6f) {
+				const float alt[3] = { 1.f, 0.f, 0.f };
+				cross(dir, alt, u);
+			}
+			normalize(u);
+			cross(dir, u, v);
+			const float * ends[2] = { p0, p1 };
+			for (int r=0; r<2; r++) {
+				const float * c = ends[r];
+				for (int k=0; k<segments; k++) {
+					const float nx = u[0]*circle_cos[k] + v[0]*circle_sin[k];
+					const float ny = u[1]*circle_cos[k] + v[1]*circle_sin[k];
+					const float nz = u[2]*circle_cos[k] + v[2]*circle_sin[k];
+					nrm[0] = nx; nrm[1] = ny; nrm[2] = nz;
+					pos[0] = c[0] + radius*nx; pos[1] = c[1] + radius*ny; pos[2] = c[2] + radius*nz;
+					pos += 3; nrm += 3;
+				}
+			}
+		}
+		
+		void ball(const float * c, float radius, float *& pos, float *& nrm) const {
+			const float * t = &sphere[0];
+			const int n = sphereVertices*3;
+			memcpy(nrm, t, n*sizeof(float));
+			for (int i=0; i<n; i+=3) {
+				pos[i+0] = c[0] + radius*t[i+0];
+				pos[i+1] = c[1] + radius*t[i+1];
+				pos[i+2] = c[2] + radius*t[i+2];
+			}
+			pos += n; nrm += n;
+		}
+		
+		void palm(const HandData& h, float *& pos, float *& nrm) const {
+			const int N = PALM_POINTS;
+			// outline: knuckles from index to pinky, then back along the metacarpal bases to the thumb
+			const float * outline[N] = {
+				h.fingers[1].bones[0].nextJoint, h.fingers[2].bones[0].nextJoint,
+				h.fingers[3].bones[0].nextJoint, h.fingers[4].bones[0].nextJoint,
+				h.fingers[4].bones[0].prevJoint, h.fingers[2].bones[0].prevJoint,
+				h.fingers[0].bones[0].prevJoint
+			};
+			float centre[3] = { 0.f, 0.f, 0.f };
+			for (int i=0; i<N; i++) for (int k=0; k<3; k++) centre[k] += outline[i][k] / N;
+			
+			// the indices expect the outline to wind anticlockwise around the palm normal,
+			// which depends on the hand:
+			float area[3] = { 0.f, 0.f, 0.f };
+			for (int i=0; i<N; i++) {
+				const float * a = outline[i], * b = outline[(i+1)%N];
+				float ea[3] = { a[0]-centre[0], a[1]-centre[1], a[2]-centre[2] };
+				float eb[3] = { b[0]-centre[0], b[1]-centre[1], b[2]-centre[2] };
+				float c[3];
+				cross(ea, eb, c);
+				for (int k=0; k<3; k++) area[k] += c[k];
+			}
+			const float * n = h.palmNormal;
+			if (area[0]*n[0] + area[1]*n[1] + area[2]*n[2] < 0.f) {
+				std::reverse(outline, outline + N);
+			}
+			const float half = h.fingers[2].bones[0].width * 0.5f;
+			
+			for (int side=0; side<2; side++) {
+				const float s = side ? -1.f : 1.f;
+				const float * pts[N+1];
+				pts[0] = centre;
+				for (int i=0; i<N; i++) pts[i+1] = outline[i];
+				for (int i=0; i<=N; i++) {
+					for (int k=0; k<3; k++) {
+						pos[k] = pts[i][k] + s*half*n[k];
+						nrm[k] = s*n[k];
+					}
+					pos += 3; nrm += 3;
+				}
+			}
+			for (int i=0; i<N; i++) {
+				const float * a = outline[i], * b = outline[(i+1)%N];
+				float edge[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+				float out[3];
+				cross(edge, n, out);
+				normalize(out);
+				const float * corner[4] = { a, a, b, b };
+				const float offset[4] = { half, -half, -half, half };
+				for (int c=0; c<4; c++) {
+					for (int k=0; k<3; k++) {
+						pos[k] = corner[c][k] + offset[c]*n[k];
+						nrm[k] = out[k];
+					}
+					pos += 3; nrm += 3;
+				}
+			}
+		}
+		
+		// writes verticesPerHand positions & normals (xyz)
+		void generate(const HandData& h, float * pos, float * nrm) const {
+			for (int f=0; f<5; f++) {
+				const FingerData& finger = h.fingers[f];
+				for (int b=0; b<4; b++) {
+					const BoneData& bone = finger.bones[b];
+					tube(bone.prevJoint, bone.nextJoint, bone.direction, h.palmNormal, bone.width*0.5f, pos, nrm);
+				}
+			}
+			for (int f=0; f<5; f++) {
+				const FingerData& finger = h.fingers[f];
+				ball(finger.bones[0].prevJoint, finger.bones[0].width*0.5f, pos, nrm);
+				for (int b=0; b<4; b++) {
+					ball(finger.bones[b].nextJoint, finger.bones[b].width*0.5f, pos, nrm);
+				}
+			}
+			palm(h, pos, nrm);
+		}
+	};
+
+    t_object	ob;			// the object itself (must be first)
+    
+	int			unique;		// only output new data
+	int			allframes;	// output all frames between each poll (rather than just the latest frame)
+	int			serialize;	// output serialized frames
+	int 		images;		// output the raw images
+	int			motion_tracking;
+	int			hmd;		// optimize for LeapVR HMD mount
+	int			background;	// capture data even when Max has lost focus
+	int			aka;		// output in a form compatible with aka.leapmotion
+	int			flat;		// output hands as flat atom lists rather than dictionaries
+	float		delta;		// if > 0, only output hand fields that changed by more than this
+	long		delta_refresh;	// with @delta, output every field every N frames
+	int			stream;		// send frames over UDP: 0 = off, 1 = OSC, 2 = binary
+	int			normalized;	// output positions normalized to the interaction box
+	int			clamp;		// with @normalized, clamp positions to 0..1
+	int			mesh;		// output a triangle mesh of the hands
+	int			retarget;	// output parent-relative bone transforms: 0 = off, 1 = quat, 2 = matrix
+	int			zone_joints;	// joints tested against zones: 0 = palm & fingertips, 1 = all
+	int			zone_inside;	// also report joints that stay inside a zone, every frame
+	long		mesh_lod;	// level of detail of the mesh, 0..3
+	long		motion;		// window of the rolling movement statistics, in frames (0 = off)
+	int			constrain;	// skeleton outlier rejection: 0 = off, 1 = report, 2 = report & repair
+	long		axes;		// axis convention: 0 = Leap (y up), 1 = z up, 2 = head-mounted
+	t_symbol *	features[FeatureVector::NUM_GROUPS];	// groups of the ML feature vector, in order
+	long		features_count;
+	float		constrain_speed;	// fastest plausible joint, in meters per second
+	float		constrain_tolerance;	// relative bone length error
+	int			strokes;	// record fingertip strokes: 0 = off, 1 = while pinching, 2 = while touching
+	long		stroke_finger;	// 0..4, thumb..pinky
+	float		stroke_spacing;	// between control points, in meters
+	long		stroke_subdivisions;	// spline vertices per control point
+	int			blobs;		// track bright blobs in the IR images
+	long		blob_threshold;	// brightness above the background, 0..255
+	float		blob_adapt;	// background learning rate per frame, 0..1
+	long		blob_min_area;	// in pixels
+	int			blob_stereo;	// triangulate blobs seen by both cameras
+	float		resample;	// output hands at this fixed rate in Hz, interpolated (0 = as tracked)
+	float		rate_images;	// maximum output rates in Hz (0 = every frame)
+	float		rate_skeleton;
+	float		rate_status;
+	int			rate_average;	// with @rate_skeleton, output the mean positions since the last output rather than the latest
+	
+	int			pose;		// classify static hand poses
+	int			pose_k;		// number of neighbours to vote
+	float		pose_threshold;	// minimum confidence to report a pose
+	
+	int			gesture_any;	// accept any gesture
+	int			gesture_swipe, gesture_circle, gesture_screen_tap, gesture_key_tap;	// enable specific gestures
+	
+	t_symbol *	config;
+	t_dictionary * config_dict;
+	float		config_values[NUM_CONFIG_KEYS];	// parsed from config_dict
+	bool		config_valid[NUM_CONFIG_KEYS];
+	t_symbol *	gesture_dict_name;
+	t_dictionary * gesture_dict;
+	std::map<int32_t, int> gesture_states;	// last reported state per gesture id
+	
+	t_symbol * frame_dict_name;
+	t_dictionary * frame_dict;
+	t_symbol *	box_dict_name;
+	t_dictionary * box_dict;
+	t_symbol *	hand_dict_name;
+	t_dictionary * hand_dict;
+	t_dictionary * arm_dict;
+	t_dictionary * palm_dict;
+	t_dictionary * finger_dicts[5];
+	t_dictionary * bone_dicts[5][4];
+	
+	void *		outlet_frame;
+	void *		outlet_image[2];
+	void *		outlet_hands;
+	void *		outlet_fingers;
+	void *		outlet_gesture;
+	void *		outlet_tracking;
+	void *		outlet_msg;
+	
+	// matrices for the IR images:
+	void *		image_wrappers[2];
+	void *		image_mats[2];
+	void *		distortion_image_wrappers[2];
+	void *		distortion_image_mats[2];
+	int			distortion_dim[2];
+	int			image_width, image_height;
+	int			distortion_requested;
+	
+	// matrices for @mesh (position, normal, index), resized only when the vertex count changes:
+	HandMesh	hand_mesh;
+	void *		mesh_wrappers[3];
+	void *		mesh_mats[3];
+	long		mesh_hands;		// hands the matrices are sized for
+	long		mesh_segments;	// segments the matrices were sized & indexed for
+	
+	ZoneSet		zone_set;
+	BlobTracker * blob_tracker;	// created on demand
+	RuleEngine	rule_engine;
+	
+	// @motion statistics & output, one matrix per left/right hand:
+	MotionStats	motion_stats;
+	void *		motion_wrappers[2];
+	void *		motion_mats[2];
+	
+	SkeletonConstraints constraints;
+	
+	// world-space output (@axes, world):
+	WorldTransform world_pose;		// as set by the world message
+	WorldTransform world_axes, world;	// the convention & the composition applied to each frame
+	
+	// @features output:
+	void *		features_wrapper;
+	void *		features_mat;
+	long		features_cells;		// what the matrix is sized for
+	
+	// @strokes, per left/right hand:
+	StrokeBuilder stroke_builders[2];
+	int32_t		stroke_ids[2];		// hand drawing the stroke, or -1
+	void *		stroke_wrappers[2];
+	void *		stroke_mats[2];
+	long		stroke_cells[2];	// what the matrices are sized for
+	
+	// @retarget output, one matrix per left/right hand:
+	Retargeter	retargeter;
+	void *		retarget_wrappers[2];
+	void *		retarget_mats[2];
+	long		retarget_planes;	// what the matrices are configured for
+	
+	Hub *		hub;
+	UdpStreamer * streamer;
+	t_symbol *	shm;		// name of the shared-memory region to publish to, if any
+	ShmPublisher * shm_publisher;
+	ColumnarWriter * exporter;	// columnar export of every processed frame, if active
+	RecordingWriter * recording;	// session recording of every live frame, if active
+	long		recorded;
+	RecordingReader * playback;	// real-time replay of a recording, if active
+	t_clock *	play_clock;
+	long		played;
+	BatchJob *	batch;		// offline feature extraction, if running
+	t_qelem *	batch_qelem;
+	long		batch_threads;	// 0 = one per core
+	std::vector<std::pair<t_symbol *, long> > stream_targets;
+	Leap::Frame lastFrame;
+	int64_t		lastFrameID;
+	
+	// the last-received frame:
+	Leap::Frame frame;
+	
+	// the last converted frame:
+	FrameData	frame_data;
+	FrameData	frame_normalized;	// a copy in interaction box coordinates, for @normalized hand output
+	
+	// output decimation (@rate_images, @rate_skeleton, @rate_status):
+	RateLimiter	image_rate, skeleton_rate, status_rate;
+	Resampler	resampler;
+	t_clock *	resample_clock;
+	bool		resample_running;
+	double		resample_next;	// ms
+	Leap::Frame	resample_frame;	// the latest input frame
+	PointAverager point_averager;
+	FrameData	frame_latest;	// frame_data before averaging
+	bool		last_connected;
+	
+	// last emitted values per hand slot, for @delta:
+	HandData	delta_hands[FrameData::MAX_HANDS];
+	int32_t		delta_ids[FrameData::MAX_HANDS];
+	long		delta_age[FrameData::MAX_HANDS];
+	
+	// preallocated buffers for @flat output (see processNextFrameFlat):
+	t_atom		flat_frame[6];
+	t_atom		flat_hand[30];
+	t_atom		flat_arm[19];
+	t_atom		flat_fingers[1 + 5*18];
+	t_atom		flat_bones[1 + 20*12];
+	
+	// static pose recognition:
+	PoseIndex	pose_index;
+	t_symbol *	pose_current[2];	// last reported pose, per left/right hand
+	t_symbol *	pose_recording;		// name being recorded, if any
+	long		pose_record_frames;	// frames left to record
+	
+	t_leap(int index = 0) {
+		
+		outlet_msg = outlet_new(&ob, 0);
+		outlet_tracking = outlet_new(&ob, 0);
+		outlet_gesture = outlet_new(&ob, 0);
+		outlet_fingers = outlet_new(&ob, "dictionary");
+		outlet_hands = outlet_new(&ob, "dictionary");
+		outlet_image[0] = outlet_new(&ob, "jit_matrix");
+		outlet_image[1] = outlet_new(&ob, "jit_matrix");
+        outlet_frame = outlet_new(&ob, 0);
+
+		// attrs:
+		unique = 0;
+		allframes = 0;
+		images = 1;
+		aka = 0;
+		flat = 0;
+		delta = 0.f;
+		delta_refresh = 30;
+		for (int i=0; i<FrameData::MAX_HANDS; i++) {
+			delta_ids[i] = -1;
+			delta_age[i] = 0;
+		}
+		stream = 0;
+		streamer = NULL;
+		shm = _sym_nothing;
+		shm_publisher = NULL;
+		exporter = NULL;
+		serialize = 0;
+		motion_tracking = 0;
+		hmd = 0;
+		background = 1;
+		
+		pose = 0;
+		pose_k = 5;
+		pose_threshold = 0.6f;
+		pose_current[0] = pose_current[1] = ps_none;
+		pose_recording = NULL;
+		pose_record_frames = 0;
+		
+		gesture_any = 0;
+		gesture_swipe = 0;
+		gesture_circle = 0;
+		gesture_screen_tap = 0;
+		gesture_key_tap = 0;
+		
+		config = jit_symbol_unique();
+		config_dict = dictionary_new();
+		for (int k=0; k<NUM_CONFIG_KEYS; k++) config_valid[k] = false;
+		gesture_dict_name = jit_symbol_unique();
+		gesture_dict = dictobj_register(dictionary_new(), &gesture_dict_name);
+		
+		frame_dict_name = jit_symbol_unique();
+		frame_dict = dictobj_register(dictionary_new(), &frame_dict_name);
+		
+		box_dict_name = jit_symbol_unique();
+		box_dict = dictobj_register(dictionary_new(), &box_dict_name);
+		
+		hand_dict_name = jit_symbol_unique();
+		hand_dict = dictobj_register(dictionary_new(), &hand_dict_name);
+		arm_dict = dictionary_new();
+		dictionary_appenddictionary(hand_dict, gensym("arm"), (t_object *)arm_dict);
+		palm_dict = dictionary_new();
+		dictionary_appenddictionary(hand_dict, gensym("palm"), (t_object *)palm_dict);
+		
+		t_dictionary * fingers_dict = dictionary_new();
+		for (int i=0; i<5; i++) {
+			t_symbol * name = 0;
+			t_dictionary * finger = dictionary_new();
+			switch (i) {
+				case 0: name = gensym("thumb"); break;
+				case 1: name = gensym("index"); break;
+				case 2: name = gensym("middle"); break;
+				case 3: name = gensym("ring"); break;
+				case 4: name = gensym("pinky"); break;
+				default: break;
+			}
+			dictionary_appendsym(finger, _sym_name, name);
+			dictionary_appenddictionary(fingers_dict, name, (t_object *)finger);
+			finger_dicts[i] = finger;
+			
+			t_dictionary * bones_dict = dictionary_new();
+			for (int b=0; b<4; b++) {
+				t_symbol * name = 0;
+				t_dictionary * bone = dictionary_new();
+				switch (i) {
+					case 0: name = gensym("metacarpal"); break;
+					case 1: name = gensym("proximal"); break;
+					case 2: name = gensym("intermediate"); break;
+					case 3: name = gensym("distal"); break;
+					default: break;
+				}
+				dictionary_appendsym(bone, _sym_name, name);
+				dictionary_appenddictionary(bones_dict, name, (t_object *)bone);
+				bone_dicts[i][b] = bone;
+			}
+			dictionary_appenddictionary(finger, gensym("fingers"), (t_object *)bones_dict);
+		}
+		dictionary_appenddictionary(hand_dict, gensym("fingers"), (t_object *)fingers_dict);
+
+		
+		// create jit.matrix for the output images:
+		image_width = 0;
+		image_height = 0;
+		distortion_dim[0] = 0;
+		distortion_dim[1] = 0;
+		for (int i=0; i<2; i++) {
+			// create matrix:
+			image_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+			image_mats[i] = NULL;
+			
+			distortion_image_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+			distortion_image_mats[i] = NULL;
+		}
+		distortion_requested = 1;
+		
+		normalized = 0;
+		clamp = 1;
+		frame_data.numHands = 0;
+		frame_data.boxSize[0] = frame_data.boxSize[1] = frame_data.boxSize[2] = 0.f;
+		
+		recording = NULL;
+		recorded = 0;
+		playback = NULL;
+		play_clock = clock_new(this, (method)playTick);
+		resample_clock = clock_new(this, (method)resampleTick);
+		resample_running = false;
+		resample_next = 0.;
+		played = 0;
+		batch = NULL;
+		batch_qelem = qelem_new(this, (method)batchDoneTick);
+		batch_threads = 0;
+		
+		zone_joints = 0;
+		zone_inside = 0;
+		
+		blobs = 0;
+		blob_threshold = 24;
+		blob_adapt = 0.02f;
+		blob_min_area = 16;
+		blob_stereo = 0;
+		blob_tracker = NULL;
+		
+		motion = 0;
+		for (int i=0; i<2; i++) {
+			motion_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+			motion_mats[i] = configureMatrix2D(motion_wrappers[i], MotionStats::NUM_FEATURES, _jit_sym_float32, NUM_JOINTS, 1);
+		}
+		
+		axes = 0;
+		features_count = 0;
+		features_wrapper = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+		features_mat = NULL;
+		features_cells = 0;
+		
+		constrain = 0;
+		constrain_speed = 4.f;
+		constrain_tolerance = 0.25f;
+		
+		strokes = 0;
+		stroke_finger = 1;
+		stroke_spacing = 0.005f;
+		stroke_subdivisions = 4;
+		for (int i=0; i<2; i++) {
+			stroke_ids[i] = -1;
+			stroke_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+			stroke_mats[i] = NULL;
+			stroke_cells[i] = 0;
+		}
+		
+		retarget = 0;
+		retarget_planes = 0;
+		for (int i=0; i<2; i++) {
+			retarget_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+			retarget_mats[i] = NULL;
+		}
+		
+		mesh = 0;
+		mesh_lod = 2;
+		mesh_hands = 0;
+		mesh_segments = 0;
+		for (int i=0; i<3; i++) {
+			mesh_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+			mesh_mats[i] = NULL;
+		}
+		
+		// internal:
+		lastFrameID = 0;
+		resample = 0.f;
+		rate_images = 0.f;
+		rate_skeleton = 0.f;
+		rate_status = 0.f;
+		rate_average = 0;
+		last_connected = false;
+		hub = Hub::acquire(this);
+    }
+    
+    ~t_leap() {
+		stream = 0;
+		updateStreamer();
+		shm = _sym_nothing;
+		updateShm();
+		exportStop();
+		recordStop();
+		playStop();
+		object_free((t_object *)play_clock);
+		clock_unset(resample_clock);
+		object_free((t_object *)resample_clock);
+		delete blob_tracker;
+		batchStop();
+		qelem_free(batch_qelem);
+		Hub::release(this);
+		for (int i=0; i<2; i++) {
+			object_release((t_object *)image_wrappers[i]);
+		}
+		for (int i=0; i<3; i++) {
+			object_release((t_object *)mesh_wrappers[i]);
+		}
+		for (int i=0; i<2; i++) {
+			object_release((t_object *)retarget_wrappers[i]);
+			object_release((t_object *)motion_wrappers[i]);
+			object_release((t_object *)stroke_wrappers[i]);
+		}
+		object_release((t_object *)features_wrapper);
+		object_release((t_object *)config_dict);
+		object_release((t_object *)gesture_dict);
+		object_release((t_object *)hand_dict);
+		object_release((t_object *)box_dict);
     }
 	
+	void * configureMatrix2D(void * mat_wrapper, long planecount, t_symbol * type, long w, long h) {
+		void * mat = jit_object_method(mat_wrapper, _jit_sym_getmatrix);
+		t_jit_matrix_info info;
+		jit_matrix_info_default(&info);
+		info.flags |= JIT_MATRIX_DATA_PACK_TIGHT;
+		info.planecount = planecount;
+		info.type = type;
+		info.dimcount = 2;
+		info.dim[0] = w;
+		info.dim[1] = h;
+		jit_object_method(mat, _jit_sym_setinfo_ex, &info);
+		return mat;
+	}
+	
+	void configure() {
+		hub->requestConfigure();
+	}
+	
+	// read the settings in config_dict into config_values (the hub pushes them)
+	void parseConfig() {
+		const ConfigKey * keys = configKeys();
+		t_dictionary * gestures = NULL;
+		for (int k=0; k<NUM_CONFIG_KEYS; k++) config_valid[k] = false;
+		if (dictionary_getdictionary(config_dict, gensym("Gesture"), (t_object **)&gestures) || !gestures) return;
+		for (int k=0; k<NUM_CONFIG_KEYS; k++) {
+			t_dictionary * group = NULL;
+			double f;
+			if (dictionary_getdictionary(gestures, gensym(keys[k].group), (t_object **)&group) == MAX_ERR_NONE && group
+				&& dictionary_getfloat(group, gensym(keys[k].key), &f) == MAX_ERR_NONE) {
+				config_values[k] = (float)f;
+				config_valid[k] = true;
+			}
+		}
+	}
+	
+	// @config names a dictionary of service settings
+	void loadConfig() {
+		if (!config || config == _sym_nothing) return;
+		t_dictionary * d = dictobj_findregistered_retain(config);
+		if (!d) return;	// not (yet) a registered dictionary
+		dictionary_clone_to_existing(d, config_dict);
+		dictobj_release(d);
+		parseConfig();
+	}
+	
+	// (re)create the streamer when @stream changes
+	void updateStreamer() {
+		if (streamer && (stream == 0 || streamer->format != stream)) {
+			hub->removeSink(streamer);
+			if (streamer->dropped) object_post(&ob, "stream: %ld frames dropped", streamer->dropped);
+			delete streamer;
+			streamer = NULL;
+		}
+		if (!streamer && stream) {
+			streamer = new UdpStreamer(stream);
+			for (size_t i=0; i<stream_targets.size(); i++) {
+				streamer->addTarget(stream_targets[i].first->s_name, (int)stream_targets[i].second);
+			}
+			hub->addSink(streamer);
+		}
+	}
+	
+	// (re)create the shared-memory publisher when @shm changes
+	void updateShm() {
+		if (shm_publisher) {
+			hub->removeSink(shm_publisher);
+			delete shm_publisher;
+			shm_publisher = NULL;
+		}
+		if (shm && shm != _sym_nothing) {
+			// one writer per region: another instance publishing to the same name would
+			// overwrite every frame, and unlink the region from under this one when freed
+			for (size_t i=0; i<hub->clients.size(); i++) {
+				const t_leap * x = hub->clients[i];
+				if (x != this && x->shm_publisher && x->shm == shm) {
+					object_error(&ob, "shared memory region %s is already published by another [leap]", shm->s_name);
+					return;
+				}
+			}
+			shm_publisher = new ShmPublisher(shm->s_name);
+			if (!shm_publisher->region) {
+				object_error(&ob, "failed to create shared memory region %s", shm->s_name);
+				delete shm_publisher;
+				shm_publisher = NULL;
+				return;
+			}
+			hub->addSink(shm_publisher);
+		}
+	}
+	
+	void addStreamTarget(t_symbol * host, long port) {
+		if (port <= 0 || port > 65535) {
+			object_error(&ob, "stream_target: invalid port %ld", port);
+			return;
+		}
+		if (streamer && !streamer->addTarget(host->s_name, (int)port)) {
+			object_error(&ob, "stream_target: can't resolve host %s", host->s_name);
+			return;
+		}
+		stream_targets.push_back(std::make_pair(host, port));
+	}
+	
+	void clearStreamTargets() {
+		stream_targets.clear();
+		if (streamer) streamer->clearTargets();
+	}
+	
 	void serializeAndOutput(const Leap::Frame& frame) {
 		t_atom a[1];
 		std::string s = frame.serialize();
@@ -398,107 +4250,105 @@ public:
 		}
 	}
 	
-	t_dictionary * processBone(const Leap::Bone& bone, bool isRight, int idx, t_symbol * name) {
-		Quaternion q;
-		Leap::Vector vec;
+	static void appendFloats(t_dictionary * d, t_symbol * key, const float * v, int n) {
 		t_atom avec[4];
+		for (int i=0; i<n; i++) atom_setfloat(avec+i, v[i]);
+		dictionary_appendatoms(d, key, n, avec);
+	}
+	
+	// @delta support: last is the last emitted state of this hand, or NULL to emit every field
+	// a field is emitted if it moved more than delta since it was last emitted
+	template<typename T>
+	static T * lastField(const HandData& h, const T * field, HandData * last) {
+		return last ? (T *)((char *)last + ((const char *)field - (const char *)&h)) : NULL;
+	}
+	
+	bool changed(const HandData& h, const float * field, int n, HandData * last) {
+		float * prev = lastField(h, field, last);
+		if (!prev) return true;
+		for (int i=0; i<n; i++) {
+			if (fabsf(field[i] - prev[i]) > delta) {
+				memcpy(prev, field, n*sizeof(float));
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	bool changed(const HandData& h, const int32_t * field, HandData * last) {
+		int32_t * prev = lastField(h, field, last);
+		if (!prev) return true;
+		if (*prev == *field) return false;
+		*prev = *field;
+		return true;
+	}
+	
+	t_dictionary * processBone(const HandData& h, const BoneData& bone, int idx, t_symbol * name, HandData * last) {
 		t_dictionary * bone_dict = dictionary_new();
 		dictionary_appendsym(bone_dict, _sym_name, name);
-		dictionary_appendlong(bone_dict, gensym("valid"), bone.isValid());
-		dictionary_appendlong(bone_dict, _sym_type, (int)bone.type());
+		if (!last) {
+			// every bone of a tracked finger is valid in the v2 SDK, the thumb's zero-length metacarpal included:
+			dictionary_appendlong(bone_dict, gensym("valid"), 1);
+			dictionary_appendlong(bone_dict, _sym_type, idx);
+		}
 		
-		dictionary_appendfloat(bone_dict, gensym("length"), bone.length() * 0.001);
-		dictionary_appendfloat(bone_dict, gensym("width"), bone.width() * 0.001);
+		if (changed(h, &bone.length, 1, last)) dictionary_appendfloat(bone_dict, gensym("length"), bone.length);
+		if (changed(h, &bone.width, 1, last)) dictionary_appendfloat(bone_dict, gensym("width"), bone.width);
 
-		q.fromBasis(bone.basis(), isRight);	// or basis.rigidInverse?
-		dictionary_appendatoms(bone_dict, gensym("quat"), 4, q.atoms);
-
-		vec = bone.center();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(bone_dict, gensym("center"), 3, avec);
-		vec = bone.nextJoint();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(bone_dict, gensym("nextJoint"), 3, avec);
-		vec = bone.prevJoint();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(bone_dict, gensym("prevJoint"), 3, avec);
-		vec = bone.direction();
-		atom_setfloat(avec+0, vec.x);
-		atom_setfloat(avec+1, vec.y);
-		atom_setfloat(avec+2, vec.z);
-		dictionary_appendatoms(bone_dict, gensym("direction"), 3, avec);
+		if (changed(h, bone.quat, 4, last)) appendFloats(bone_dict, gensym("quat"), bone.quat, 4);
+		if (changed(h, bone.center, 3, last)) appendFloats(bone_dict, gensym("center"), bone.center, 3);
+		if (changed(h, bone.nextJoint, 3, last)) appendFloats(bone_dict, gensym("nextJoint"), bone.nextJoint, 3);
+		if (changed(h, bone.prevJoint, 3, last)) appendFloats(bone_dict, gensym("prevJoint"), bone.prevJoint, 3);
+		if (changed(h, bone.direction, 3, last)) appendFloats(bone_dict, gensym("direction"), bone.direction, 3);
 
+		// with @delta, unchanged bones are left out entirely:
+		if (last && dictionary_getentrycount(bone_dict) <= 1) {
+			object_free(bone_dict);
+			return NULL;
+		}
 		return bone_dict;
 	}
 	
-	t_dictionary * processFinger(const Leap::Finger& finger, bool isRight, int idx, t_symbol * name) {
-		Quaternion q;
-		Leap::Vector vec;
-		t_atom avec[4];
+	t_dictionary * processFinger(const HandData& h, const FingerData& finger, int idx, t_symbol * name, HandData * last) {
 		t_dictionary * finger_dict = dictionary_new();
-		bool isValid = finger.isValid();
 		
-		dictionary_appendlong(finger_dict, gensym("valid"), isValid);
-		const int32_t id = finger.id();
-		dictionary_appendlong(finger_dict, _sym_id, id);
+		dictionary_appendlong(finger_dict, _sym_id, finger.id);
 		dictionary_appendsym(finger_dict, _sym_type, name);
-		//dictionary_appendlong(finger_dict, gensym("frame"), frame_id);
-		//dictionary_appendlong(finger_dict, gensym("hand"), hand_id);
-		dictionary_appendfloat(finger_dict, gensym("timeVisible"), finger.timeVisible());
-		dictionary_appendlong(finger_dict, gensym("extended"), finger.isExtended());
-		dictionary_appendfloat(finger_dict, gensym("length"), finger.length() * 0.001);
-		dictionary_appendfloat(finger_dict, gensym("width"), finger.width() * 0.001);
-
-		dictionary_appendfloat(finger_dict, gensym("touchDistance"), finger.touchDistance());
-		switch (finger.touchZone()) {
-			case Leap::Pointable::ZONE_NONE:
-				dictionary_appendsym(finger_dict, gensym("touchZone"), gensym("none"));
-				break;
-			case Leap::Pointable::ZONE_HOVERING:
-				dictionary_appendsym(finger_dict, gensym("touchZone"), gensym("hovering"));
-				break;
-			case Leap::Pointable::ZONE_TOUCHING:
-				dictionary_appendsym(finger_dict, gensym("touchZone"), gensym("touching"));
-				break;
-			default:
-				break;
+		if (!last) {
+			// as are the 5 fingers of a tracked hand:
+			dictionary_appendlong(finger_dict, gensym("valid"), 1);
+			dictionary_appendfloat(finger_dict, gensym("timeVisible"), finger.timeVisible);
 		}
+		if (changed(h, &finger.extended, last)) dictionary_appendlong(finger_dict, gensym("extended"), finger.extended);
+		if (changed(h, &finger.length, 1, last)) dictionary_appendfloat(finger_dict, gensym("length"), finger.length);
+		if (changed(h, &finger.width, 1, last)) dictionary_appendfloat(finger_dict, gensym("width"), finger.width);
 
-		vec = finger.direction();
-		atom_setfloat(avec+0, vec.x);
-		atom_setfloat(avec+1, vec.y);
-		atom_setfloat(avec+2, vec.z);
-		dictionary_appendatoms(finger_dict, gensym("direction"), 3, avec);
-
-		vec = finger.tipPosition();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(finger_dict, gensym("tipPosition"), 3, avec);
-
-		vec = finger.stabilizedTipPosition();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(finger_dict, gensym("stabilizedTipPosition"), 3, avec);
+		if (changed(h, &finger.touchDistance, 1, last)) dictionary_appendfloat(finger_dict, gensym("touchDistance"), finger.touchDistance);
+		if (changed(h, &finger.touchZone, last)) {
+			switch (finger.touchZone) {
+				case Leap::Pointable::ZONE_NONE:
+					dictionary_appendsym(finger_dict, gensym("touchZone"), gensym("none"));
+					break;
+				case Leap::Pointable::ZONE_HOVERING:
+					dictionary_appendsym(finger_dict, gensym("touchZone"), gensym("hovering"));
+					break;
+				case Leap::Pointable::ZONE_TOUCHING:
+					dictionary_appendsym(finger_dict, gensym("touchZone"), gensym("touching"));
+					break;
+				default:
+					break;
+			}
+		}
 
-		vec = finger.tipVelocity();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(finger_dict, gensym("tipVelocity"), 3, avec);
+		if (changed(h, finger.direction, 3, last)) appendFloats(finger_dict, gensym("direction"), finger.direction, 3);
+		if (changed(h, finger.tipPosition, 3, last)) appendFloats(finger_dict, gensym("tipPosition"), finger.tipPosition, 3);
+		if (changed(h, finger.stabilizedTipPosition, 3, last)) appendFloats(finger_dict, gensym("stabilizedTipPosition"), finger.stabilizedTipPosition, 3);
+		if (changed(h, finger.tipVelocity, 3, last)) appendFloats(finger_dict, gensym("tipVelocity"), finger.tipVelocity, 3);
 		
 		// bones:
 		t_atom bone_atoms[4];
+		int numBones = 0;
 		for (int b=0; b<4; b++) {
-			const Leap::Bone::Type boneType = static_cast<Leap::Bone::Type>(b);
-			const Leap::Bone bone = finger.bone(boneType);
 			t_symbol * name = 0;
 			switch (b) {
 				case 0: name = gensym("metacarpal"); break;
@@ -508,13 +4358,16 @@ public:
 				default: break;
 			}
 			
-			t_dictionary * bone_dict = processBone(bone, isRight, b, name);
-			dictionary_appendsym(bone_dict, _sym_name, name);
-			//dictionary_appenddictionary(bones_dict, name, (t_object *)bone_dict);
-			atom_setobj(bone_atoms+b, bone_dict);
+			t_dictionary * bone_dict = processBone(h, finger.bones[b], b, name, last);
+			if (bone_dict) atom_setobj(bone_atoms + numBones++, bone_dict);
 		}
-		dictionary_appendatoms(finger_dict, gensym("bones"), 4, bone_atoms);
+		if (numBones) dictionary_appendatoms(finger_dict, gensym("bones"), numBones, bone_atoms);
 		
+		// with @delta, unchanged fingers are left out entirely (id & type are always present):
+		if (last && dictionary_getentrycount(finger_dict) <= 2) {
+			object_free(finger_dict);
+			return NULL;
+		}
 		return finger_dict;
 	}
 	
@@ -575,106 +4428,60 @@ public:
 		return tool_dict;
 	}
 	
-	t_dictionary * processHand(const Leap::Hand& hand) {
+	// hand is only used for data relative to the previous frame, and tools
+	// with @delta, last holds the last emitted values (see changed())
+	t_dictionary * processHand(const HandData& h, const Leap::Hand& hand, HandData * last) {
 		t_dictionary * hand_dict = dictionary_new();
-		Quaternion q;
 		Leap::Vector vec;
 		t_atom avec[4];
-		const bool isRight = hand.isRight();
-		const int32_t hand_id = hand.id();
-		const Leap::Arm &arm = hand.arm();
 		
-		dictionary_appendlong(hand_dict, _sym_id, hand_id);
-		dictionary_appendlong(hand_dict, gensym("frame"), (t_atom_long)hand.frame().id());
-		dictionary_appendsym(hand_dict, gensym("hand"), isRight ? gensym("right") : gensym("left"));
-		dictionary_appendfloat(hand_dict, gensym("timeVisible"), hand.timeVisible());
-		dictionary_appendfloat(hand_dict, gensym("confidence"), hand.confidence());
-		dictionary_appendfloat(hand_dict, gensym("grabStrength"), hand.grabStrength()); // open hand (0) to grabbing pose (1)
-		dictionary_appendfloat(hand_dict, gensym("pinchStrength"), hand.pinchStrength()); // open hand (0) to pinching pose (1)
+		dictionary_appendlong(hand_dict, _sym_id, h.id);
+		dictionary_appendlong(hand_dict, gensym("frame"), (t_atom_long)frame_data.id);
+		dictionary_appendsym(hand_dict, gensym("hand"), h.isRight ? gensym("right") : gensym("left"));
+		if (delta > 0.f) dictionary_appendlong(hand_dict, gensym("full"), last == NULL);
+		if (!last) dictionary_appendfloat(hand_dict, gensym("timeVisible"), h.timeVisible);
+		if (changed(h, &h.confidence, 1, last)) dictionary_appendfloat(hand_dict, gensym("confidence"), h.confidence);
+		if (changed(h, &h.grabStrength, 1, last)) dictionary_appendfloat(hand_dict, gensym("grabStrength"), h.grabStrength); // open hand (0) to grabbing pose (1)
+		if (changed(h, &h.pinchStrength, 1, last)) dictionary_appendfloat(hand_dict, gensym("pinchStrength"), h.pinchStrength); // open hand (0) to pinching pose (1)
 		
 		t_dictionary * palm_dict = dictionary_new();
 		{
 			// palm
-			vec = hand.direction();
-			atom_setfloat(avec+0, vec.x);
-			atom_setfloat(avec+1, vec.y);
-			atom_setfloat(avec+2, vec.z);
-			dictionary_appendatoms(palm_dict, _jit_sym_direction, 3, avec);
-			
-			vec = hand.palmPosition();
-			atom_setfloat(avec+0, vec.x * 0.001);
-			atom_setfloat(avec+1, vec.y * 0.001);
-			atom_setfloat(avec+2, vec.z * 0.001);
-			dictionary_appendatoms(palm_dict, gensym("position"), 3, avec);
-			
-			vec = hand.stabilizedPalmPosition();
-			atom_setfloat(avec+0, vec.x * 0.001);
-			atom_setfloat(avec+1, vec.y * 0.001);
-			atom_setfloat(avec+2, vec.z * 0.001);
-			dictionary_appendatoms(palm_dict, gensym("stabilizedPosition"), 3, avec);
-			
-			vec = hand.palmNormal();
-			atom_setfloat(avec+0, vec.x);
-			atom_setfloat(avec+1, vec.y);
-			atom_setfloat(avec+2, vec.z);
-			dictionary_appendatoms(palm_dict, gensym("normal"), 3, avec);
-			
-			vec = hand.palmVelocity();
-			atom_setfloat(avec+0, vec.x * 0.001);
-			atom_setfloat(avec+1, vec.y * 0.001);
-			atom_setfloat(avec+2, vec.z * 0.001);
-			dictionary_appendatoms(palm_dict, gensym("velocity"), 3, avec);
-			
-			dictionary_appendfloat(palm_dict, gensym("width"), hand.palmWidth() * 0.001); // in meters
-			
-			q.fromBasis(hand.basis(), isRight);	// or basis.rigidInverse?
-			dictionary_appendatoms(palm_dict, gensym("quat"), 4, q.atoms);
+			if (changed(h, h.direction, 3, last)) appendFloats(palm_dict, _jit_sym_direction, h.direction, 3);
+			if (changed(h, h.palmPosition, 3, last)) appendFloats(palm_dict, gensym("position"), h.palmPosition, 3);
+			if (changed(h, h.stabilizedPalmPosition, 3, last)) appendFloats(palm_dict, gensym("stabilizedPosition"), h.stabilizedPalmPosition, 3);
+			if (changed(h, h.palmNormal, 3, last)) appendFloats(palm_dict, gensym("normal"), h.palmNormal, 3);
+			if (changed(h, h.palmVelocity, 3, last)) appendFloats(palm_dict, gensym("velocity"), h.palmVelocity, 3);
+			if (changed(h, &h.palmWidth, 1, last)) dictionary_appendfloat(palm_dict, gensym("width"), h.palmWidth); // in meters
+			if (changed(h, h.palmQuat, 4, last)) appendFloats(palm_dict, gensym("quat"), h.palmQuat, 4);
 		}
 		dictionary_appenddictionary(hand_dict, gensym("palm"), (t_object *)palm_dict);
 		
-		if (arm.isValid()) {
+		if (h.armValid) {
 			t_dictionary * arm_dict = dictionary_new();
 			{
-				q.fromBasis(arm.basis(), isRight);	// or basis.rigidInverse?
-				dictionary_appendatoms(arm_dict, gensym("quat"), 4, q.atoms);
-				
-				vec = arm.center();
-				atom_setfloat(avec+0, vec.x * 0.001);
-				atom_setfloat(avec+1, vec.y * 0.001);
-				atom_setfloat(avec+2, vec.z * 0.001);
-				dictionary_appendatoms(arm_dict, gensym("center"), 3, avec);
-				
-				vec = arm.elbowPosition();
-				atom_setfloat(avec+0, vec.x * 0.001);
-				atom_setfloat(avec+1, vec.y * 0.001);
-				atom_setfloat(avec+2, vec.z * 0.001);
-				dictionary_appendatoms(arm_dict, gensym("elbowPosition"), 3, avec);
-				
-				Leap::Vector vec1 = arm.wristPosition();
-				atom_setfloat(avec+0, vec1.x * 0.001);
-				atom_setfloat(avec+1, vec1.y * 0.001);
-				atom_setfloat(avec+2, vec1.z * 0.001);
-				dictionary_appendatoms(arm_dict, gensym("wristPosition"), 3, avec);
+				if (changed(h, h.armQuat, 4, last)) appendFloats(arm_dict, gensym("quat"), h.armQuat, 4);
+				if (changed(h, h.armCenter, 3, last)) appendFloats(arm_dict, gensym("center"), h.armCenter, 3);
+				bool elbow = changed(h, h.elbowPosition, 3, last);
+				bool wrist = changed(h, h.wristPosition, 3, last);
+				if (elbow) appendFloats(arm_dict, gensym("elbowPosition"), h.elbowPosition, 3);
+				if (wrist) appendFloats(arm_dict, gensym("wristPosition"), h.wristPosition, 3);
 				
 				// probably also want length:
-				float x1 = vec1.x-vec.x;
-				float y1 = vec1.y-vec.y;
-				float z1 = vec1.z-vec.z;
+				float x1 = h.wristPosition[0]-h.elbowPosition[0];
+				float y1 = h.wristPosition[1]-h.elbowPosition[1];
+				float z1 = h.wristPosition[2]-h.elbowPosition[2];
 				float len = sqrtf(x1*x1+y1*y1+z1*z1);
 				
-				dictionary_appendfloat(arm_dict, gensym("length"), len * 0.001); // in meters
-				dictionary_appendfloat(arm_dict, gensym("width"), arm.width() * 0.001); // in meters
-				
-				vec = arm.direction();
-				atom_setfloat(avec+0, vec.x);
-				atom_setfloat(avec+1, vec.y);
-				atom_setfloat(avec+2, vec.z);
-				dictionary_appendatoms(arm_dict, gensym("direction"), 3, avec);
+				if (elbow || wrist) dictionary_appendfloat(arm_dict, gensym("length"), len); // in meters
+				if (changed(h, &h.armWidth, 1, last)) dictionary_appendfloat(arm_dict, gensym("width"), h.armWidth); // in meters
+				if (changed(h, h.armDirection, 3, last)) appendFloats(arm_dict, gensym("direction"), h.armDirection, 3);
 			}
 			dictionary_appenddictionary(hand_dict, gensym("arm"), (t_object *)arm_dict);
 		}
 		
-		{
+		// (per-frame values, so sent with @delta too:)
+		if (hand.isValid()) {
 			// transform since last frame:
 			float angle = hand.rotationAngle(lastFrame);
 			vec = hand.rotationAxis(lastFrame);
@@ -696,19 +4503,14 @@ public:
 		}
 		{
 			// sphere to fit this hand:
-			vec = hand.sphereCenter();
-			atom_setfloat(avec+0, vec.x * 0.001);
-			atom_setfloat(avec+1, vec.y * 0.001);
-			atom_setfloat(avec+2, vec.z * 0.001);
-			dictionary_appendatoms(hand_dict, gensym("sphereCenter"), 3, avec);
-			dictionary_appendfloat(hand_dict, gensym("sphereRadius"), hand.sphereRadius() * 0.001); // in meters
+			if (changed(h, h.sphereCenter, 3, last)) appendFloats(hand_dict, gensym("sphereCenter"), h.sphereCenter, 3);
+			if (changed(h, &h.sphereRadius, 1, last)) dictionary_appendfloat(hand_dict, gensym("sphereRadius"), h.sphereRadius); // in meters
 		}
 		
 		// fingers:
-		const Leap::FingerList &fingers = hand.fingers();
 		t_atom finger_atoms[5];
+		int numFingers = 0;
 		for (int i=0; i<5; i++) {
-			const Leap::Finger& finger = fingers[i];
 			t_symbol * name = 0;
 			switch (i) {
 				case 0: name = gensym("thumb"); break;
@@ -717,18 +4519,18 @@ public:
 				case 3: name = gensym("ring"); break;
 				default: name = gensym("pinky"); break;
 			}
-			t_dictionary * finger_dict = processFinger(fingers[i], isRight, 1, name);
-			atom_setobj(finger_atoms+i, finger_dict);
+			t_dictionary * finger_dict = processFinger(h, h.fingers[i], i, name, last);
+			if (finger_dict) atom_setobj(finger_atoms + numFingers++, finger_dict);
 		}
-		dictionary_appendatoms(hand_dict, gensym("fingers"), 5, finger_atoms);
+		if (numFingers) dictionary_appendatoms(hand_dict, gensym("fingers"), numFingers, finger_atoms);
 		
 		const Leap::ToolList& tools = hand.tools();
-		size_t numTools = tools.count();
+		size_t numTools = hand.isValid() ? tools.count() : 0;
 		if (numTools) {
 			t_atom tool_atoms[numTools];
 			for (size_t i = 0; i<numTools; i++) {
 				t_dictionary * tool_dict = processTool(tools[i]);
-				
+				atom_setobj(tool_atoms+i, tool_dict);
 			}
 			dictionary_appendatoms(hand_dict, gensym("tools"), numTools, tool_atoms);
 		}
@@ -736,88 +4538,34 @@ public:
 		return hand_dict;
 	}
 	
-	void processNextFrame(const Leap::Frame& frame, int serialize=0) {
+	// f is the converted frame (frame_data, or its @normalized copy)
+	void processNextFrame(const Leap::Frame& frame, const FrameData& f) {
 		
 		if (!frame.isValid()) return;
 		
 		dictionary_clear(frame_dict);
 		
 		t_atom a[2];
-		t_atom avec[4];
-		Leap::Vector vec;
-		Leap::Matrix basis;
-		Quaternion q;
-		
-		// serialize:
-		if (serialize) serializeAndOutput(frame);
-		
-		int64_t frame_id = frame.id();
-		
-		// The objects returned by the Frame object are all read-only.
-		// You can safely store them and use them in the future.
-		// They are thread-safe.
-		const Leap::HandList hands = frame.hands();
-		const Leap::PointableList pointables = frame.pointables();
-		const Leap::FingerList fingers = frame.fingers();
-		const Leap::ToolList tools = frame.tools();
-		
 		
 		// TODO: Following entities across frames
 		// perhaps have an attribute for an ID to track?
 		// hand = frame.hand(handID);
 		// finger = frame.finger(fingerID) etc.
 		
-		const size_t numHands = hands.count();
-		
-		t_atom frame_data[6];
-		atom_setlong(frame_data, frame_id);
-		atom_setlong(frame_data+1, frame.timestamp());
-		atom_setlong(frame_data+2, numHands);
+		t_atom frame_atoms[6];
+		atom_setlong(frame_atoms, f.id);
+		atom_setlong(frame_atoms+1, f.timestamp);
+		atom_setlong(frame_atoms+2, f.numHands);
 		// front-most hand ID:
-		atom_setlong(frame_data+3, frame.hands().frontmost().id());
-		atom_setlong(frame_data+4, frame.hands().leftmost().id());
-		atom_setlong(frame_data+5, frame.hands().rightmost().id());
-		outlet_anything(outlet_frame, ps_frame, 6, frame_data);
-		
-//		dictionary_appendlong(hand_dict, gensym("fingerFrontmost"), fingers.frontmost().id()); // in meters
-//		dictionary_appendlong(hand_dict, gensym("fingerLeftmost"), fingers.leftmost().id()); // in meters
-//		dictionary_appendlong(hand_dict, gensym("fingerRightmost"), fingers.rightmost().id()); // in meters
-		
-		// motion tracking
-		// motion tracking data is preceded by a probability vector (Rotate, Scale, Translate)
-		if (motion_tracking) {
-			t_atom transform[4];
-			Leap::Vector vec;
-			
-			atom_setfloat(transform+0, frame.rotationProbability(lastFrame));
-			atom_setfloat(transform+1, frame.scaleProbability(lastFrame));
-			atom_setfloat(transform+2, frame.translationProbability(lastFrame));
-			outlet_anything(outlet_tracking, ps_probability, 3, frame_data);
-			
-			vec = frame.rotationAxis(lastFrame);
-			atom_setfloat(transform, frame.rotationAngle(lastFrame));
-			atom_setfloat(transform+1, vec.x);
-			atom_setfloat(transform+2, vec.y);
-			atom_setfloat(transform+3, vec.z);
-			outlet_anything(outlet_tracking, _jit_sym_rotate, 4, frame_data);
-			
-			atom_setfloat(transform, frame.scaleFactor(lastFrame));
-			outlet_anything(outlet_tracking, _jit_sym_scale, 1, frame_data);
-			
-			vec = frame.translation(lastFrame);
-			atom_setfloat(transform+0, vec.x);
-			atom_setfloat(transform+1, vec.y);
-			atom_setfloat(transform+2, vec.z);
-			outlet_anything(outlet_tracking, _jit_sym_position, 3, frame_data);
-		}
-		
-		
-		t_atom hand_atoms[numHands];
-		for(size_t i = 0; i < numHands; i++) {
-			const Leap::Hand &hand = hands[i];
-			if (!hand.isValid()) continue;
-			
-			t_dictionary * hand_dict = processHand(hand);
+		atom_setlong(frame_atoms+3, f.frontmost);
+		atom_setlong(frame_atoms+4, f.leftmost);
+		atom_setlong(frame_atoms+5, f.rightmost);
+		outlet_anything(outlet_frame, ps_frame, 6, frame_atoms);
+		
+		deltaBegin();
+		for (int i = 0; i < f.numHands; i++) {
+			const HandData& h = f.hands[i];
+			t_dictionary * hand_dict = processHand(h, frame.hand(h.id), deltaSlot(h));
 			
 			t_symbol * name = jit_symbol_unique();
 			hand_dict = dictobj_register(hand_dict, &name);
@@ -825,35 +4573,224 @@ public:
 			outlet_anything(outlet_hands, _sym_dictionary, 1, a);
 			object_release((t_object *)hand_dict);
 		}
-		//dictionary_appendatoms()
-		
 		
 		outlet_anything(outlet_frame, ps_frame_end, 0, NULL);
 	}
 	
-	void getBox() {
-		t_atom avec[4];
-		t_atom a[1];
+	// motion tracking, relative to the last poll
+	// motion tracking data is preceded by a probability vector (Rotate, Scale, Translate)
+	void outputMotionTracking(const Leap::Frame& frame) {
+		t_atom transform[4];
 		Leap::Vector vec;
-		const Leap::InteractionBox& box = frame.interactionBox();
-		t_symbol * box_dict_name = jit_symbol_unique();
-		t_dictionary * box_dict = dictobj_register(dictionary_new(), &box_dict_name);
 		
-		vec = box.center();
-		atom_setfloat(avec+0, vec.x * 0.001);
-		atom_setfloat(avec+1, vec.y * 0.001);
-		atom_setfloat(avec+2, vec.z * 0.001);
-		dictionary_appendatoms(box_dict, gensym("center"), 3, avec);
+		atom_setfloat(transform+0, frame.rotationProbability(lastFrame));
+		atom_setfloat(transform+1, frame.scaleProbability(lastFrame));
+		atom_setfloat(transform+2, frame.translationProbability(lastFrame));
+		outlet_anything(outlet_tracking, ps_probability, 3, transform);
+		
+		vec = frame.rotationAxis(lastFrame);
+		atom_setfloat(transform, frame.rotationAngle(lastFrame));
+		atom_setfloat(transform+1, vec.x);
+		atom_setfloat(transform+2, vec.y);
+		atom_setfloat(transform+3, vec.z);
+		outlet_anything(outlet_tracking, _jit_sym_rotate, 4, transform);
+		
+		atom_setfloat(transform, frame.scaleFactor(lastFrame));
+		outlet_anything(outlet_tracking, _jit_sym_scale, 1, transform);
 		
-		vec = box.center();
-		atom_setfloat(avec+0, box.width() * 0.001);
-		atom_setfloat(avec+1, box.height() * 0.001);
-		atom_setfloat(avec+2, box.depth() * 0.001);
-		dictionary_appendatoms(box_dict, gensym("size"), 3, avec);
+		vec = frame.translation(lastFrame);
+		atom_setfloat(transform+0, vec.x);
+		atom_setfloat(transform+1, vec.y);
+		atom_setfloat(transform+2, vec.z);
+		outlet_anything(outlet_tracking, _jit_sym_position, 3, transform);
+	}
+	
+	// the interaction box of the last processed frame, in meters
+	void getBox() {
+		const FrameData& f = frame_data;
+		if (f.boxSize[0] <= 0.f) return;	// no frame yet
+		appendFloats(box_dict, gensym("center"), f.boxCenter, 3);
+		appendFloats(box_dict, gensym("size"), f.boxSize, 3);
 		
+		t_atom a[1];
 		atom_setsym(a, box_dict_name);
 		outlet_anything(outlet_msg, gensym("interactionBox"), 1, a);
-		object_release((t_object *)box_dict);
+	}
+	
+	// @delta: forget hands that are no longer tracked
+	void deltaBegin() {
+		for (int i=0; i<FrameData::MAX_HANDS; i++) {
+			bool present = false;
+			for (int j=0; j<frame_data.numHands && !present; j++) {
+				present = (frame_data.hands[j].id == delta_ids[i]);
+			}
+			if (!present) delta_ids[i] = -1;
+		}
+	}
+	
+	// @delta: the last emitted state of this hand,
+	// or NULL if every field should be emitted (new hand, periodic refresh, or @delta 0)
+	HandData * deltaSlot(const HandData& h) {
+		if (delta <= 0.f) return NULL;
+		int slot = -1;
+		for (int i=0; i<FrameData::MAX_HANDS; i++) {
+			if (delta_ids[i] == h.id) {
+				if (delta_refresh > 0 && ++delta_age[i] >= delta_refresh) {
+					slot = i;	// refresh
+					break;
+				}
+				return &delta_hands[i];
+			}
+		}
+		for (int i=0; i<FrameData::MAX_HANDS && slot < 0; i++) {
+			if (delta_ids[i] < 0) slot = i;
+		}
+		if (slot >= 0) {
+			delta_ids[slot] = h.id;
+			delta_age[slot] = 0;
+			delta_hands[slot] = h;
+		}
+		return NULL;
+	}
+	
+	// @delta for @flat: compare & remember a whole message's worth of values
+	bool rangeChanged(const HandData& h, const void * begin, const void * end, HandData * last) {
+		const float * v = (const float *)begin;
+		const int n = (int)(((const char *)end - (const char *)begin) / sizeof(float));
+		return changed(h, v, n, last);
+	}
+	
+	static t_atom * setFloats(t_atom * a, const float * v, int n) {
+		for (int i=0; i<n; i++) atom_setfloat(a++, v[i]);
+		return a;
+	}
+	
+	/*
+		@flat 1 output schema (all messages from the leftmost outlet)
+		positions, velocities, lengths & widths in meters; quats as x y z w
+		
+		frame_start
+		frame <frame id> <timestamp> <num hands> <frontmost id> <leftmost id> <rightmost id>
+		per hand:
+			hand <hand id> <right> <confidence> <grabStrength> <pinchStrength> <timeVisible>
+				<palm position xyz> <stabilized palm position xyz> <palm normal xyz> <direction xyz> <palm velocity xyz>
+				<palm quat xyzw> <palm width> <sphere center xyz> <sphere radius>
+			arm <hand id> <valid> <elbow xyz> <wrist xyz> <center xyz> <direction xyz> <quat xyzw> <width>
+			fingers <hand id>, then for each of thumb, index, middle, ring, pinky:
+				<finger id> <extended> <touchZone> <touchDistance> <length> <width>
+				<tip position xyz> <stabilized tip position xyz> <tip velocity xyz> <direction xyz>
+			bones <hand id>, then for each finger, for each of metacarpal, proximal, intermediate, distal:
+				<prevJoint xyz> <nextJoint xyz> <quat xyzw> <length> <width>
+		frame_end
+	*/
+	void processNextFrameFlat(const Leap::Frame& frame, const FrameData& f) {
+		
+		if (!frame.isValid()) return;
+		
+		
+		outlet_anything(outlet_frame, ps_frame_start, 0, NULL);
+		
+		atom_setlong(flat_frame+0, f.id);
+		atom_setlong(flat_frame+1, f.timestamp);
+		atom_setlong(flat_frame+2, f.numHands);
+		atom_setlong(flat_frame+3, f.frontmost);
+		atom_setlong(flat_frame+4, f.leftmost);
+		atom_setlong(flat_frame+5, f.rightmost);
+		outlet_anything(outlet_frame, ps_frame, 6, flat_frame);
+		
+		deltaBegin();
+		for (int i=0; i<f.numHands; i++) {
+			const HandData& h = f.hands[i];
+			HandData * last = deltaSlot(h);
+			t_atom * a;
+			
+			// with @delta, a message is only sent if any of its values changed
+			// (timeVisible alone doesn't count)
+			bool hand_changed = rangeChanged(h, &h.confidence, &h.timeVisible, last);
+			hand_changed = rangeChanged(h, h.palmPosition, &h.sphereRadius + 1, last) || hand_changed;
+			bool arm_changed = changed(h, &h.armValid, last);
+			arm_changed = rangeChanged(h, h.elbowPosition, &h.armWidth + 1, last) || arm_changed;
+			bool fingers_changed = false;
+			bool bones_changed = false;
+			for (int j=0; j<5; j++) {
+				const FingerData& fd = h.fingers[j];
+				fingers_changed = changed(h, &fd.extended, last) || fingers_changed;
+				fingers_changed = changed(h, &fd.touchZone, last) || fingers_changed;
+				fingers_changed = rangeChanged(h, &fd.touchDistance, &fd.timeVisible, last) || fingers_changed;
+				fingers_changed = rangeChanged(h, fd.tipPosition, fd.bones, last) || fingers_changed;
+				bones_changed = rangeChanged(h, fd.bones, fd.bones + 4, last) || bones_changed;
+			}
+			
+			if (hand_changed) {
+			a = flat_hand;
+			atom_setlong(a++, h.id);
+			atom_setlong(a++, h.isRight);
+			atom_setfloat(a++, h.confidence);
+			atom_setfloat(a++, h.grabStrength);
+			atom_setfloat(a++, h.pinchStrength);
+			atom_setfloat(a++, h.timeVisible);
+			a = setFloats(a, h.palmPosition, 3);
+			a = setFloats(a, h.stabilizedPalmPosition, 3);
+			a = setFloats(a, h.palmNormal, 3);
+			a = setFloats(a, h.direction, 3);
+			a = setFloats(a, h.palmVelocity, 3);
+			a = setFloats(a, h.palmQuat, 4);
+			atom_setfloat(a++, h.palmWidth);
+			a = setFloats(a, h.sphereCenter, 3);
+			atom_setfloat(a++, h.sphereRadius);
+			outlet_anything(outlet_frame, ps_hand, a - flat_hand, flat_hand);
+			}
+			
+			if (arm_changed) {
+			a = flat_arm;
+			atom_setlong(a++, h.id);
+			atom_setlong(a++, h.armValid);
+			a = setFloats(a, h.elbowPosition, 3);
+			a = setFloats(a, h.wristPosition, 3);
+			a = setFloats(a, h.armCenter, 3);
+			a = setFloats(a, h.armDirection, 3);
+			a = setFloats(a, h.armQuat, 4);
+			atom_setfloat(a++, h.armWidth);
+			outlet_anything(outlet_frame, ps_arm, a - flat_arm, flat_arm);
+			}
+			
+			if (fingers_changed) {
+			a = flat_fingers;
+			atom_setlong(a++, h.id);
+			for (int j=0; j<5; j++) {
+				const FingerData& fd = h.fingers[j];
+				atom_setlong(a++, fd.id);
+				atom_setlong(a++, fd.extended);
+				atom_setlong(a++, fd.touchZone);
+				atom_setfloat(a++, fd.touchDistance);
+				atom_setfloat(a++, fd.length);
+				atom_setfloat(a++, fd.width);
+				a = setFloats(a, fd.tipPosition, 3);
+				a = setFloats(a, fd.stabilizedTipPosition, 3);
+				a = setFloats(a, fd.tipVelocity, 3);
+				a = setFloats(a, fd.direction, 3);
+			}
+			outlet_anything(outlet_frame, ps_fingers, a - flat_fingers, flat_fingers);
+			}
+			
+			if (bones_changed) {
+			a = flat_bones;
+			atom_setlong(a++, h.id);
+			for (int j=0; j<5; j++) {
+				for (int b=0; b<4; b++) {
+					const BoneData& bd = h.fingers[j].bones[b];
+					a = setFloats(a, bd.prevJoint, 3);
+					a = setFloats(a, bd.nextJoint, 3);
+					a = setFloats(a, bd.quat, 4);
+					atom_setfloat(a++, bd.length);
+					atom_setfloat(a++, bd.width);
+				}
+			}
+			outlet_anything(outlet_frame, ps_bones, a - flat_bones, flat_bones);
+			}
+		}
+		
+		outlet_anything(outlet_frame, ps_frame_end, 0, NULL);
 	}
 	
 	// compatibilty with aka.leapmotion:
@@ -962,6 +4899,38 @@ public:
 		}
 	}
 	
+	// output an 8-bit IR image (live or replayed) from the image outlet of its camera
+	void outputImage(int idx, const unsigned char * pixels, int width, int height) {
+		if (width != image_width || height != image_height) {
+			image_height = height;
+			image_width = width;
+			for (int i=0; i<2; i++) {
+				//image_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
+				image_mats[i] = configureMatrix2D(image_wrappers[i], 1, _jit_sym_char, image_width, image_height);
+			}
+			object_post(&ob, "IR image dimensions: width %i height %i", image_width, image_height);
+		}
+		
+		t_atom a[1];
+		void * mat_wrapper = image_wrappers[idx];
+		void * mat = image_mats[idx];
+		
+		// lock it:
+		long in_savelock = (long)jit_object_method(mat, _jit_sym_lock, 1);
+		{
+			// copy into image:
+			char * out_bp;
+			jit_object_method(mat, _jit_sym_getdata, &out_bp);
+			memcpy(out_bp, pixels, image_width*image_height);
+		}
+		// restore matrix lock state:
+		jit_object_method(mat, _jit_sym_lock, in_savelock);
+		
+		// output image:
+		atom_setsym(a, jit_attr_getsym(mat_wrapper, _jit_sym_name));
+		outlet_anything(outlet_image[idx], _jit_sym_jit_matrix, 1, a);
+	}
+	
 	void processImageList(const Leap::ImageList& images) {
 		t_atom a[3];
 		long in_savelock;
@@ -974,17 +4943,6 @@ public:
 			const Leap::Image& image = images[0];
 			if (!image.isValid()) return;
 			
-			if (image.width() != image_width || image.height() != image_height) {
-				image_height = image.height();
-				image_width = image.width();
-				for (int i=0; i<2; i++) {
-					//image_wrappers[i] = jit_object_new(gensym("jit_matrix_wrapper"), jit_symbol_unique(), 0, NULL);
-					image_mats[i] = configureMatrix2D(image_wrappers[i], 1, _jit_sym_char, image_width, image_height);
-				}
-				object_post(&ob, "IR image dimensions: width %i height %i", image_width, image_height);
-				
-			}
-			
 			if (image.distortionWidth()/2 != distortion_dim[0] || image.distortionHeight() != distortion_dim[1]) {
 				distortion_dim[0] = image.distortionWidth()/2;
 				distortion_dim[1] = image.distortionHeight();
@@ -1008,23 +4966,8 @@ public:
 					return;
 				}
 				
-				void * mat_wrapper = image_wrappers[idx];
-				void * mat = image_mats[idx];
-				
-				// lock it:
-				in_savelock = (long)jit_object_method(mat, _jit_sym_lock, 1);
-				{
-					// copy into image:
-					char * out_bp;
-					jit_object_method(mat, _jit_sym_getdata, &out_bp);
-					memcpy(out_bp, image.data(), image_width*image_height);
-				}
-				// restore matrix lock state:
-				jit_object_method(mat, _jit_sym_lock, in_savelock);
-				
-				// output image:
-				atom_setsym(a, jit_attr_getsym(mat_wrapper, _jit_sym_name));
-				outlet_anything(outlet_image[idx], _jit_sym_jit_matrix, 1, a);
+				if (recording) recording->addImage(idx, image.data(), image.width(), image.height());
+				outputImage(idx, image.data(), image.width(), image.height());
 				
 				if (distortion_requested) {
 					void * mat_wrapper = distortion_image_wrappers[idx];
@@ -1056,207 +4999,1332 @@ public:
 					outlet_anything(outlet_msg, gensym("distortion"), 3, a);
 					
 				}
-				
-				/*
-				 see https://developer.leapmotion.com/documentation/cpp/api/Leap.Image.html#cppclass_leap_1_1_image_1a4c6fa722eba7018e148b13677c7ce609
-				 */
+				
+				/*
+				 see https://developer.leapmotion.com/documentation/cpp/api/Leap.Image.html#cppclass_leap_1_1_image_1a4c6fa722eba7018e148b13677c7ce609
+				 */
+			}
+		}
+		
+		distortion_requested = 0;
+		
+		if (blobs) {
+			const uint8_t * pixels[2] = { NULL, NULL };
+			for (int i = 0; i < 2; i++) {
+				const Leap::Image& image = images[i];
+				if (image.isValid() && image.id() >= 0 && image.id() < 2) pixels[image.id()] = image.data();
+			}
+			processBlobs(pixels, image_width, image_height, &images);
+		}
+	}
+	
+	/*
+		@blobs output (from the leftmost outlet), per camera (0 = left, 1 = right):
+		blobs <camera> <count>
+		blob <camera> <index> <centroid x> <centroid y> <area> <left> <top> <right> <bottom>	(pixels, largest first)
+		with @blob_stereo, for blobs matched between the cameras (live images only):
+		blob3d <left index> <right index> <x> <y> <z>	(meters, in world space like the hands)
+	*/
+	void processBlobs(const uint8_t * pixels[2], int width, int height, const Leap::ImageList * images) {
+		if (width <= 0 || height <= 0) return;
+		if (!blob_tracker) blob_tracker = new BlobTracker;
+		BlobTracker& tracker = *blob_tracker;
+		tracker.threshold = (int)blob_threshold;
+		tracker.rate = (int)(blob_adapt * 256.f + 0.5f);
+		tracker.minArea = (int)blob_min_area;
+		tracker.run(pixels, width, height);
+		
+		t_atom a[9];
+		for (int c=0; c<2; c++) {
+			if (!pixels[c]) continue;
+			const std::vector<BlobTracker::Blob>& list = tracker.cameras[c].blobs;
+			atom_setlong(a, c);
+			atom_setlong(a+1, (long)list.size());
+			outlet_anything(outlet_msg, gensym("blobs"), 2, a);
+			for (size_t i=0; i<list.size(); i++) {
+				const BlobTracker::Blob& b = list[i];
+				atom_setlong(a+1, (long)i);
+				atom_setfloat(a+2, b.cx);
+				atom_setfloat(a+3, b.cy);
+				atom_setlong(a+4, b.area);
+				atom_setlong(a+5, b.x0);
+				atom_setlong(a+6, b.y0);
+				atom_setlong(a+7, b.x1);
+				atom_setlong(a+8, b.y1);
+				outlet_anything(outlet_msg, gensym("blob"), 9, a);
+			}
+		}
+		if (blob_stereo && images && pixels[0] && pixels[1]) triangulateBlobs(*images);
+	}
+	
+	// match blobs along the (rectified) epipolar lines and triangulate them,
+	// with the cameras 40mm apart along x
+	void triangulateBlobs(const Leap::ImageList& images) {
+		Leap::Image camera[2];
+		for (int i = 0; i < 2; i++) {
+			const Leap::Image& image = images[i];
+			if (image.isValid() && image.id() >= 0 && image.id() < 2) camera[image.id()] = image;
+		}
+		if (!camera[0].isValid() || !camera[1].isValid()) return;
+		const std::vector<BlobTracker::Blob>& left = blob_tracker->cameras[0].blobs;
+		const std::vector<BlobTracker::Blob>& right = blob_tracker->cameras[1].blobs;
+		
+		// ray slopes of each centroid:
+		float slopes[2][BlobTracker::MAX_BLOBS][2];
+		for (int c=0; c<2; c++) {
+			const std::vector<BlobTracker::Blob>& list = c ? right : left;
+			for (size_t i=0; i<list.size(); i++) {
+				const Leap::Vector v = camera[c].rectify(Leap::Vector(list[i].cx, list[i].cy, 0));
+				slopes[c][i][0] = v.x;
+				slopes[c][i][1] = v.y;
+			}
+		}
+		
+		const float baseline = 0.04f, tolerance = 0.05f;
+		bool used[BlobTracker::MAX_BLOBS] = { false };
+		const bool transformed = updateWorld();
+		t_atom a[5];
+		for (size_t i=0; i<left.size(); i++) {
+			if (slopes[0][i][0] != slopes[0][i][0]) continue;	// outside the calibrated area (NaN)
+			int best = -1;
+			float bestError = tolerance;
+			for (size_t j=0; j<right.size(); j++) {
+				const float disparity = slopes[0][i][0] - slopes[1][j][0];
+				const float error = fabsf(slopes[0][i][1] - slopes[1][j][1]);
+				if (used[j] || !(disparity > 0.f) || !(error < bestError)) continue;
+				best = (int)j;
+				bestError = error;
+			}
+			if (best < 0) continue;
+			used[best] = true;
+			const float y = baseline / (slopes[0][i][0] - slopes[1][best][0]);
+			float p[3] = { slopes[0][i][0] * y - baseline * 0.5f, y, 0.5f * (slopes[0][i][1] + slopes[1][best][1]) * y };
+			if (transformed) world.transformPoint(p, 1.f);
+			atom_setlong(a, (long)i);
+			atom_setlong(a+1, best);
+			atom_setfloat(a+2, p[0]);
+			atom_setfloat(a+3, p[1]);
+			atom_setfloat(a+4, p[2]);
+			outlet_anything(outlet_msg, gensym("blob3d"), 5, a);
+		}
+	}
+	
+	static void appendVector(t_dictionary * d, t_symbol * key, const Leap::Vector& vec) {
+		t_atom avec[3];
+		atom_setfloat(avec, vec.x);
+		atom_setfloat(avec+1, vec.y);
+		atom_setfloat(avec+2, vec.z);
+		dictionary_appendatoms(d, key, 3, avec);
+	}
+	
+	t_dictionary * processGesture(const Leap::Gesture& gesture) {
+		t_dictionary * d = dictionary_new();
+		
+		dictionary_appendlong(d, _sym_id, gesture.id());
+		switch (gesture.state()) {
+			case Leap::Gesture::STATE_START:
+				dictionary_appendsym(d, ps_state, ps_start);
+				break;
+			case Leap::Gesture::STATE_UPDATE:
+				dictionary_appendsym(d, ps_state, ps_update);
+				break;
+			case Leap::Gesture::STATE_STOP:
+				dictionary_appendsym(d, ps_state, ps_stop);
+				break;
+			default:
+				break;
+		}
+		
+		Leap::HandList hands = gesture.hands();
+		if (hands.count()) dictionary_appendlong(d, ps_hand, (*hands.begin()).id());
+		dictionary_appendfloat(d, ps_duration, gesture.durationSeconds());
+		
+		switch (gesture.type()) {
+			case Leap::Gesture::TYPE_SWIPE: {
+				const Leap::SwipeGesture g = gesture;
+				dictionary_appendsym(d, _sym_type, ps_swipe);
+				dictionary_appendlong(d, ps_pointable, g.pointable().id());
+				appendVector(d, _jit_sym_position, g.position());
+				appendVector(d, _jit_sym_direction, g.direction());
+				appendVector(d, ps_startPosition, g.startPosition());
+				dictionary_appendfloat(d, ps_speed, g.speed());
+			} break;
+			case Leap::Gesture::TYPE_CIRCLE: {
+				const Leap::CircleGesture g = gesture;
+				dictionary_appendsym(d, _sym_type, ps_circle);
+				dictionary_appendlong(d, ps_pointable, g.pointable().id());
+				appendVector(d, ps_center, g.center());
+				appendVector(d, ps_normal, g.normal());
+				dictionary_appendfloat(d, ps_progress, g.progress());
+				dictionary_appendfloat(d, ps_radius, g.radius());
+			} break;
+			case Leap::Gesture::TYPE_KEY_TAP: {
+				const Leap::KeyTapGesture g = gesture;
+				dictionary_appendsym(d, _sym_type, ps_key_tap);
+				dictionary_appendlong(d, ps_pointable, g.pointable().id());
+				appendVector(d, _jit_sym_position, g.position());
+				appendVector(d, _jit_sym_direction, g.direction());
+			} break;
+			case Leap::Gesture::TYPE_SCREEN_TAP: {
+				const Leap::ScreenTapGesture g = gesture;
+				dictionary_appendsym(d, _sym_type, ps_screen_tap);
+				dictionary_appendlong(d, ps_pointable, g.pointable().id());
+				appendVector(d, _jit_sym_position, g.position());
+				appendVector(d, _jit_sym_direction, g.direction());
+			} break;
+			default: {
+				//Handle unrecognized gestures?
+				object_free(d);
+				d = NULL;
+			} break;
+		}
+		return d;
+	}
+	
+	// other instances may have enabled gestures this one doesn't want:
+	bool gestureEnabled(Leap::Gesture::Type type) const {
+		if (gesture_any) return true;
+		switch (type) {
+			case Leap::Gesture::TYPE_SWIPE: return gesture_swipe;
+			case Leap::Gesture::TYPE_CIRCLE: return gesture_circle;
+			case Leap::Gesture::TYPE_SCREEN_TAP: return gesture_screen_tap;
+			case Leap::Gesture::TYPE_KEY_TAP: return gesture_key_tap;
+			default: return false;
+		}
+	}
+	
+	// output all gestures of a frame as a single dictionary
+	// if since is valid, gestures of intermediate frames are included too
+	// (the same gesture can be reported by several frames, so each id is
+	// emitted once per state, and only once for start/stop)
+	void processGestures(const Leap::Frame& frame, const Leap::Frame& since) {
+		const Leap::GestureList gestures = since.isValid() ? frame.gestures(since) : frame.gestures();
+		const int count = gestures.count();
+		if (count == 0) return;
+		
+		std::vector<t_atom> gesture_atoms;
+		gesture_atoms.reserve(count);
+		
+		// the list is most recent first; walk it oldest first, so that a gesture's start
+		// is seen (and recorded in gesture_states) before its updates & stop:
+		for (int i=count-1; i>=0; i--) {
+			const Leap::Gesture& g = gestures[i];
+			if (!g.isValid()) continue;
+			const int32_t id = g.id();
+			const int state = (int)g.state();
+			
+			// a more recent record with the same id & state in this batch? (report the latest)
+			bool duplicate = false;
+			for (int j=0; j<i && !duplicate; j++) {
+				duplicate = (gestures[j].id() == id && (int)gestures[j].state() == state);
+			}
+			if (duplicate) continue;
+			
+			// already reported in an earlier batch?
+			std::map<int32_t, int>::iterator it = gesture_states.find(id);
+			if (it != gesture_states.end()) {
+				if (state == Leap::Gesture::STATE_START || it->second == Leap::Gesture::STATE_STOP) continue;
+			}
+			
+			if (!gestureEnabled(g.type())) continue;
+			
+			t_dictionary * d = processGesture(g);
+			if (!d) continue;
+			t_atom a;
+			atom_setobj(&a, d);
+			gesture_atoms.push_back(a);
+			gesture_states[id] = state;
+		}
+		
+		// forget finished gestures once they can no longer be reported:
+		if (gesture_states.size() > 256) {
+			for (std::map<int32_t, int>::iterator it = gesture_states.begin(); it != gesture_states.end();) {
+				if (it->second == Leap::Gesture::STATE_STOP) {
+					gesture_states.erase(it++);
+				} else {
+					++it;
+				}
+			}
+		}
+		
+		if (gesture_atoms.empty()) return;
+		
+		dictionary_clear(gesture_dict);
+		dictionary_appendlong(gesture_dict, ps_frame, (t_atom_long)frame.id());
+		dictionary_appendatoms(gesture_dict, ps_gestures, gesture_atoms.size(), &gesture_atoms[0]);
+		
+		t_atom a[1];
+		atom_setsym(a, gesture_dict_name);
+		outlet_anything(outlet_gesture, _sym_dictionary, 1, a);
+	}
+	
+	// trigger zones: "zone enter|exit|inside <zone> <left|right> <joint> <hand id>"
+	// expects frame_data to hold the converted frame
+	void processZones() {
+		static const int tips[6] = { JOINT_PALM, JOINT_FINGERS + 4, JOINT_FINGERS + 9, JOINT_FINGERS + 14, JOINT_FINGERS + 19, JOINT_FINGERS + 24 };
+		ZoneSet& zs = zone_set;
+		zs.beginFrame();
+		for (int i=0; i<frame_data.numHands; i++) {
+			const HandData& h = frame_data.hands[i];
+			const int n = zone_joints ? NUM_JOINTS : 6;
+			for (int j=0; j<n; j++) {
+				const int joint = zone_joints ? j : tips[j];
+				zs.test(h.id, h.isRight != 0, joint, jointPosition(h, joint));
+			}
+		}
+		zs.endFrame();
+		
+		for (size_t i=0; i<zs.exits.size(); i++) zoneEvent(ps_exit, zs.exits[i].first, zs.exits[i].second);
+		zs.exits.clear();
+		
+		// merge the sorted lists: only in previous = exit, only in inside = enter
+		size_t a = 0, b = 0;
+		while (a < zs.previous.size() || b < zs.inside.size()) {
+			if (b >= zs.inside.size() || (a < zs.previous.size() && zs.previous[a] < zs.inside[b])) {
+				zoneEvent(ps_exit, zs.previous[a++]);
+			} else if (a >= zs.previous.size() || zs.inside[b] < zs.previous[a]) {
+				zoneEvent(ps_enter, zs.inside[b++]);
+			} else {
+				if (zone_inside) zoneEvent(ps_inside, zs.inside[b]);
+				a++; b++;
+			}
+		}
+	}
+	
+	void zoneEvent(t_symbol * type, const ZoneSet::Entry& e, t_symbol * zone = NULL) {
+		t_atom a[5];
+		atom_setsym(a, type);
+		atom_setsym(a+1, zone ? zone : zone_set.zones[e.zone].name);
+		atom_setsym(a+2, e.right ? ps_right : ps_left);
+		atom_setsym(a+3, gensym(jointName(e.joint)));
+		atom_setlong(a+4, e.hand);
+		outlet_anything(outlet_gesture, ps_zone, 5, a);
+	}
+	
+	// zones from a dictionary: { <name> : { "sphere" : [ x y z radius ] } or { "box" : [ x0 y0 z0 x1 y1 z1 ] }, ... }
+	void zonesFromDictionary(t_symbol * s) {
+		t_dictionary * d = dictobj_findregistered_retain(s);
+		if (!d) {
+			object_error(&ob, "zones: unable to reference dictionary named %s", s->s_name);
+			return;
+		}
+		long numkeys = 0;
+		t_symbol ** keys = NULL;
+		dictionary_getkeys(d, &numkeys, &keys);
+		for (long i=0; i<numkeys; i++) {
+			t_dictionary * zone = NULL;
+			long argc = 0;
+			t_atom * argv = NULL;
+			if (dictionary_getdictionary(d, keys[i], (t_object **)&zone) || !zone) continue;
+			if (!dictionary_getatoms(zone, gensym("sphere"), &argc, &argv) && argc >= 4) {
+				zoneSet(ps_sphere, keys[i], argc, argv);
+			} else if (!dictionary_getatoms(zone, gensym("box"), &argc, &argv) && argc >= 6) {
+				zoneSet(gensym("box"), keys[i], argc, argv);
+			} else {
+				object_warn(&ob, "zones: %s needs a sphere [x y z radius] or box [x0 y0 z0 x1 y1 z1]", keys[i]->s_name);
+			}
+		}
+		if (keys) dictionary_freekeys(d, numkeys, keys);
+		dictobj_release(d);
+	}
+	
+	void zoneSet(t_symbol * type, t_symbol * name, long argc, t_atom * argv) {
+		float v[6];
+		for (int i=0; i<6; i++) v[i] = (i < argc) ? (float)atom_getfloat(argv+i) : 0.f;
+		if (type == ps_sphere) {
+			if (argc < 4) {
+				object_error(&ob, "zone_sphere <name> <x> <y> <z> <radius>");
+				return;
+			}
+			zone_set.setSphere(name, v, v[3]);
+		} else {
+			if (argc < 6) {
+				object_error(&ob, "zone_box <name> <x0> <y0> <z0> <x1> <y1> <z1>");
+				return;
+			}
+			zone_set.setBox(name, v, v+3);
+		}
+		if (zone_set.zones.size() > 32767) {
+			object_error(&ob, "too many zones");
+			zone_set.remove(name);
+		}
+	}
+	
+	// expects frame_data to hold the converted frame
+	void processRules() {
+		const FrameData& f = frame_data;
+		const HandData * sides[2] = { NULL, NULL };	// the first left & right hands
+		for (int i=0; i<f.numHands; i++) {
+			const int side = f.hands[i].isRight ? 1 : 0;
+			if (!sides[side]) sides[side] = &f.hands[i];
+		}
+		for (size_t i=0; i<rule_engine.rules.size(); i++) {
+			RuleEngine::Rule& r = rule_engine.rules[i];
+			if (RuleEngine::twoHanded(r)) {
+				const bool present = sides[0] && sides[1];
+				const float v = present ? RuleEngine::value(r, *sides[0], *sides[1]) : 0.f;
+				int change = RuleEngine::step(r, 0, present, v, f.timestamp);
+				r.value[0] = v;
+				if (change) ruleEvent(r, change > 0, ps_both, v);
+				continue;
+			}
+			for (int side=0; side<2; side++) {
+				if ((r.hand == RuleEngine::HAND_LEFT && side == 1) || (r.hand == RuleEngine::HAND_RIGHT && side == 0)) continue;
+				const float v = sides[side] ? RuleEngine::value(r, *sides[side]) : 0.f;
+				int change = RuleEngine::step(r, side, sides[side] != NULL, v, f.timestamp);
+				r.value[side] = v;
+				if (change) ruleEvent(r, change > 0, side ? ps_right : ps_left, v);
+			}
+		}
+	}
+	
+	void ruleEvent(const RuleEngine::Rule& r, bool on, t_symbol * side, float v) {
+		t_atom a[4];
+		atom_setsym(a, r.name);
+		atom_setsym(a+1, on ? gensym("on") : gensym("off"));
+		atom_setsym(a+2, side);
+		atom_setfloat(a+3, v);
+		outlet_anything(outlet_gesture, ps_rule, 4, a);
+	}
+	
+	// compile the rules in a dictionary (see RuleEngine), replacing any previous rules
+	void rulesFromDictionary(t_symbol * s) {
+		t_dictionary * d = dictobj_findregistered_retain(s);
+		if (!d) {
+			object_error(&ob, "rules: unable to reference dictionary named %s", s->s_name);
+			return;
+		}
+		long numkeys = 0;
+		t_symbol ** keys = NULL;
+		dictionary_getkeys(d, &numkeys, &keys);
+		std::vector<RuleEngine::Rule> rules;
+		for (long i=0; i<numkeys; i++) {
+			t_dictionary * rd = NULL;
+			if (dictionary_getdictionary(d, keys[i], (t_object **)&rd) || !rd) continue;
+			RuleEngine::Rule r;
+			t_symbol * field = _sym_nothing;
+			t_symbol * hand = _sym_nothing;
+			double threshold = 0., release = 0., hold = 0.;
+			r.name = keys[i];
+			dictionary_getsym(rd, gensym("field"), &field);
+			if (!RuleEngine::resolve(field->s_name, r)) {
+				object_error(&ob, "rules: %s has an unknown field %s", keys[i]->s_name, field->s_name);
+				continue;
+			}
+			if (!dictionary_getfloat(rd, gensym("above"), &threshold)) {
+				r.below = 0;
+			} else if (!dictionary_getfloat(rd, gensym("below"), &threshold)) {
+				r.below = 1;
+			} else {
+				object_error(&ob, "rules: %s needs an above or below threshold", keys[i]->s_name);
+				continue;
+			}
+			if (dictionary_getfloat(rd, gensym("release"), &release)) release = threshold;
+			dictionary_getfloat(rd, gensym("for"), &hold);
+			dictionary_getsym(rd, gensym("hand"), &hand);
+			r.threshold = (float)threshold;
+			r.release = (float)release;
+			r.hold = (int64_t)(hold * 1000.);
+			r.hand = (hand == ps_left) ? RuleEngine::HAND_LEFT : (hand == ps_right) ? RuleEngine::HAND_RIGHT : RuleEngine::HAND_ANY;
+			for (int side=0; side<2; side++) {
+				r.active[side] = 0;
+				r.since[side] = -1;
+				r.value[side] = 0.f;
+			}
+			rules.push_back(r);
+		}
+		if (keys) dictionary_freekeys(d, numkeys, keys);
+		dictobj_release(d);
+		rulesReplace(rules);
+	}
+	
+	// rules that are on stay on if a new rule has the same name and covers the same hand,
+	// any others are turned off, so that nothing downstream is left stuck on
+	void rulesReplace(std::vector<RuleEngine::Rule>& rules) {
+		std::vector<RuleEngine::Rule>& old = rule_engine.rules;
+		for (size_t i=0; i<old.size(); i++) {
+			const RuleEngine::Rule& o = old[i];
+			RuleEngine::Rule * n = NULL;
+			for (size_t j=0; j<rules.size() && !n; j++) {
+				if (rules[j].name == o.name && RuleEngine::twoHanded(rules[j]) == RuleEngine::twoHanded(o)) n = &rules[j];
+			}
+			const bool both = RuleEngine::twoHanded(o);
+			for (int side=0; side<(both ? 1 : 2); side++) {
+				const bool covered = n && (both
+					|| n->hand == RuleEngine::HAND_ANY
+					|| n->hand == (side ? RuleEngine::HAND_RIGHT : RuleEngine::HAND_LEFT));
+				if (covered) {
+					n->active[side] = o.active[side];
+					n->since[side] = o.since[side];
+					n->value[side] = o.value[side];
+				} else if (o.active[side]) {
+					ruleEvent(o, false, both ? ps_both : side ? ps_right : ps_left, o.value[side]);
+				}
+			}
+		}
+		old.swap(rules);
+	}
+	
+	void rulesClear() {
+		std::vector<RuleEngine::Rule> none;
+		rulesReplace(none);
+	}
+	
+	// expects frame_data to hold the converted frame
+	void processPoses() {
+		float features[PoseIndex::DIM];
+		t_symbol * found[2] = { ps_none, ps_none };
+		float confidence[2] = { 0.f, 0.f };
+
+		for (int i=0; i<frame_data.numHands; i++) {
+			const HandData& hand = frame_data.hands[i];
+			int side = hand.isRight ? 1 : 0;
+			PoseIndex::features(hand, features);
+
+			if (pose_recording && pose_record_frames > 0) {
+				pose_index.add(pose_recording, features);
+			}
+			if (!pose) continue;
+
+			float c = 0.f;
+			t_symbol * name = pose_index.classify(features, pose_k, c);
+			if (name && c >= pose_threshold && c > confidence[side]) {
+				found[side] = name;
+				confidence[side] = c;
+			}
+		}
+
+		if (pose_recording && pose_record_frames > 0 && frame_data.numHands > 0) {
+			if (--pose_record_frames == 0) {
+				object_post(&ob, "recorded pose %s (%ld samples total)", pose_recording->s_name, (long)pose_index.size());
+				pose_recording = NULL;
+			}
+		}
+
+		// only report changes:
+		for (int side=0; pose && side<2; side++) {
+			if (found[side] != pose_current[side]) {
+				t_atom a[3];
+				pose_current[side] = found[side];
+				atom_setsym(a, found[side]);
+				atom_setfloat(a+1, confidence[side]);
+				atom_setsym(a+2, side ? ps_right : ps_left);
+				outlet_anything(outlet_gesture, ps_pose, 3, a);
+			}
+		}
+	}
+
+	void poseRecord(t_symbol * name, long frames) {
+		if (name == _sym_nothing) {
+			pose_recording = NULL;
+			pose_record_frames = 0;
+			return;
+		}
+		pose_recording = name;
+		pose_record_frames = frames > 0 ? frames : 1;
+	}
+
+	// resolve a filename (or a dialog if none given) to a Max path:
+	bool resolveFile(t_symbol * s, bool forWriting, const char * defaultName, char * filename, short * path) {
+		t_fourcc type = 0;
+		if (s == _sym_nothing) {
+			strncpy_zero(filename, defaultName, MAX_FILENAME_CHARS);
+			if (forWriting) {
+				if (saveas_dialog(filename, path, NULL)) return false;
+			} else {
+				if (open_dialog(filename, path, &type, NULL, 0)) return false;
+			}
+			return true;
+		}
+		if (forWriting) {
+			if (path_frompathname(s->s_name, path, filename)) {
+				strncpy_zero(filename, s->s_name, MAX_FILENAME_CHARS);
+				*path = path_getdefault();
+			}
+		} else {
+			strncpy_zero(filename, s->s_name, MAX_FILENAME_CHARS);
+			if (locatefile_extended(filename, path, &type, NULL, 0)) {
+				object_error(&ob, "can't find file %s", s->s_name);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void poseWrite(t_symbol * s) {
+		char filename[MAX_FILENAME_CHARS];
+		short path = 0;
+		if (!resolveFile(s, true, "poses.json", filename, &path)) return;
+
+		t_dictionary * d = dictionary_new();
+		dictionary_appendlong(d, gensym("dim"), PoseIndex::DIM);
+		dictionary_appendlong(d, gensym("version"), PoseIndex::FILE_VERSION);
+		t_dictionary * poses_dict = dictionary_new();
+		for (size_t p=0; p<pose_index.names.size(); p++) {
+			std::vector<t_atom> atoms;
+			for (size_t i=0; i<pose_index.size(); i++) {
+				if (pose_index.labels[i] != (int)p) continue;
+				const float * f = &pose_index.samples[i*PoseIndex::DIM];
+				for (int j=0; j<PoseIndex::DIM; j++) {
+					t_atom a;
+					atom_setfloat(&a, f[j]);
+					atoms.push_back(a);
+				}
+			}
+			if (atoms.size()) dictionary_appendatoms(poses_dict, pose_index.names[p], atoms.size(), &atoms[0]);
+		}
+		dictionary_appenddictionary(d, gensym("poses"), (t_object *)poses_dict);
+
+		if (dictionary_write(d, filename, path)) {
+			object_error(&ob, "failed to write poses to %s", filename);
+		}
+		object_free(d);
+	}
+
+	void poseRead(t_symbol * s) {
+		char filename[MAX_FILENAME_CHARS];
+		short path = 0;
+		if (!resolveFile(s, false, "poses.json", filename, &path)) return;
+
+		t_dictionary * d = NULL;
+		if (dictionary_read(filename, path, &d) || !d) {
+			object_error(&ob, "failed to read poses from %s", filename);
+			return;
+		}
+		t_atom_long dim = 0, version = 1;
+		t_dictionary * poses_dict = NULL;
+		dictionary_getlong(d, gensym("dim"), &dim);
+		dictionary_getlong(d, gensym("version"), &version);
+		dictionary_getdictionary(d, gensym("poses"), (t_object **)&poses_dict);
+		if (dim != PoseIndex::DIM || !poses_dict) {
+			object_error(&ob, "%s is not a compatible pose file", filename);
+			object_free(d);
+			return;
+		}
+
+		pose_index.clear();
+		long numkeys = 0;
+		t_symbol ** keys = NULL;
+		dictionary_getkeys(poses_dict, &numkeys, &keys);
+		for (long k=0; k<numkeys; k++) {
+			long argc = 0;
+			t_atom * argv = NULL;
+			dictionary_getatoms(poses_dict, keys[k], &argc, &argv);
+			float f[PoseIndex::DIM];
+			for (long i=0; i+PoseIndex::DIM <= argc; i += PoseIndex::DIM) {
+				for (int j=0; j<PoseIndex::DIM; j++) f[j] = atom_getfloat(argv+i+j);
+				pose_index.add(keys[k], f);
+			}
+		}
+		if (keys) dictionary_freekeys(poses_dict, numkeys, keys);
+		object_free(d);
+		object_post(&ob, "read %ld pose samples (%ld poses)", (long)pose_index.size(), (long)pose_index.names.size());
+		if (version < PoseIndex::FILE_VERSION) {
+			object_warn(&ob, "%s is from an older version: poses recorded with the left hand are mirrored and should be recorded again", filename);
+		}
+	}
+
+	// @mesh: all tracked hands as one indexed triangle mesh, for jit.gl.mesh @draw_mode triangles
+	// outputs "mesh_hands <count>", then (if there are hands) the index, normal and position matrices,
+	// position last so that it can drive the left inlet of jit.gl.mesh
+	void processMesh() {
+		const FrameData& f = frame_data;
+		t_atom a[2];
+		long in_savelock;
+		
+		atom_setlong(a, f.numHands);
+		outlet_anything(outlet_msg, gensym("mesh_hands"), 1, a);
+		if (!f.numHands) return;
+		
+		hand_mesh.setLOD(mesh_lod);
+		const bool resized = (mesh_hands != f.numHands || mesh_segments != hand_mesh.segments);
+		if (resized) {
+			mesh_hands = f.numHands;
+			mesh_segments = hand_mesh.segments;
+			mesh_mats[0] = configureMatrix2D(mesh_wrappers[0], 3, _jit_sym_float32, hand_mesh.verticesPerHand * mesh_hands, 1);
+			mesh_mats[1] = configureMatrix2D(mesh_wrappers[1], 3, _jit_sym_float32, hand_mesh.verticesPerHand * mesh_hands, 1);
+			mesh_mats[2] = configureMatrix2D(mesh_wrappers[2], 1, _jit_sym_long, hand_mesh.indicesPerHand * mesh_hands, 1);
+			
+			// the topology only changes here:
+			in_savelock = (long)jit_object_method(mesh_mats[2], _jit_sym_lock, 1);
+			{
+				char * bp;
+				jit_object_method(mesh_mats[2], _jit_sym_getdata, &bp);
+				for (int i=0; i<f.numHands; i++) {
+					hand_mesh.writeIndices((int32_t *)bp + i*hand_mesh.indicesPerHand, i*hand_mesh.verticesPerHand);
+				}
+			}
+			jit_object_method(mesh_mats[2], _jit_sym_lock, in_savelock);
+		}
+		
+		long pos_savelock = (long)jit_object_method(mesh_mats[0], _jit_sym_lock, 1);
+		long nrm_savelock = (long)jit_object_method(mesh_mats[1], _jit_sym_lock, 1);
+		{
+			char * pos, * nrm;
+			jit_object_method(mesh_mats[0], _jit_sym_getdata, &pos);
+			jit_object_method(mesh_mats[1], _jit_sym_getdata, &nrm);
+			for (int i=0; i<f.numHands; i++) {
+				const int offset = i * hand_mesh.verticesPerHand * 3;
+				hand_mesh.generate(f.hands[i], (float *)pos + offset, (float *)nrm + offset);
+			}
+		}
+		jit_object_method(mesh_mats[1], _jit_sym_lock, nrm_savelock);
+		jit_object_method(mesh_mats[0], _jit_sym_lock, pos_savelock);
+		
+		static const char * names[3] = { "mesh_position", "mesh_normal", "mesh_index" };
+		for (int i=2; i>=0; i--) {
+			atom_setsym(a, _jit_sym_jit_matrix);
+			atom_setsym(a+1, jit_attr_getsym(mesh_wrappers[i], _jit_sym_name));
+			outlet_anything(outlet_msg, gensym(names[i]), 2, a);
+		}
+	}
+	
+	// @retarget: "retarget <left|right> jit_matrix <name>" per tracked hand (the first of each side),
+	// a float32 matrix of 21 cells (see Retargeter) with either
+	// 7 planes (@retarget quat): x y z qx qy qz qw, or
+	// 16 planes (@retarget matrix): a column-major 4x4 transform, as used by OpenGL
+	void processRetarget() {
+		const FrameData& f = frame_data;
+		const long planes = (retarget == 2) ? 16 : 7;
+		if (planes != retarget_planes) {
+			retarget_planes = planes;
+			for (int i=0; i<2; i++) {
+				retarget_mats[i] = configureMatrix2D(retarget_wrappers[i], planes, _jit_sym_float32, Retargeter::NUM_NODES, 1);
+			}
+		}
+		
+		bool done[2] = { false, false };
+		for (int i=0; i<f.numHands; i++) {
+			const HandData& h = f.hands[i];
+			const int side = h.isRight ? 1 : 0;
+			if (done[side]) continue;
+			done[side] = true;
+			
+			float quats[Retargeter::NUM_NODES][4];
+			float offsets[Retargeter::NUM_NODES][3];
+			retargeter.compute(h, quats, offsets);
+			
+			void * mat = retarget_mats[side];
+			long savelock = (long)jit_object_method(mat, _jit_sym_lock, 1);
+			{
+				char * bp;
+				jit_object_method(mat, _jit_sym_getdata, &bp);
+				float * out = (float *)bp;
+				for (int n=0; n<Retargeter::NUM_NODES; n++, out += planes) {
+					const float * q = quats[n];
+					const float * t = offsets[n];
+					if (planes == 7) {
+						out[0] = t[0]; out[1] = t[1]; out[2] = t[2];
+						out[3] = q[0]; out[4] = q[1]; out[5] = q[2]; out[6] = q[3];
+					} else {
+						const float x = q[0], y = q[1], z = q[2], w = q[3];
+						out[0] = 1.f - 2.f*(y*y + z*z);	out[1] = 2.f*(x*y + z*w);		out[2] = 2.f*(x*z - y*w);		out[3] = 0.f;
+						out[4] = 2.f*(x*y - z*w);		out[5] = 1.f - 2.f*(x*x + z*z);	out[6] = 2.f*(y*z + x*w);		out[7] = 0.f;
+						out[8] = 2.f*(x*z + y*w);		out[9] = 2.f*(y*z - x*w);		out[10] = 1.f - 2.f*(x*x + y*y);	out[11] = 0.f;
+						out[12] = t[0];				out[13] = t[1];				out[14] = t[2];				out[15] = 1.f;
+					}
+				}
+			}
+			jit_object_method(mat, _jit_sym_lock, savelock);
+			
+			t_atom a[3];
+			atom_setsym(a, h.isRight ? ps_right : ps_left);
+			atom_setsym(a+1, _jit_sym_jit_matrix);
+			atom_setsym(a+2, jit_attr_getsym(retarget_wrappers[side], _jit_sym_name));
+			outlet_anything(outlet_msg, gensym("retarget"), 3, a);
+		}
+	}
+	
+	// @constrain: check (and repair) frame_data before anything else sees it;
+	// bad joints are reported as "outliers <left|right> <hand id> <joint name>..."
+	void processConstraints() {
+		FrameData& f = frame_data;
+		constraints.maxSpeed = constrain_speed;
+		constraints.tolerance = constrain_tolerance;
+		// hands already tracked keep their state (even if their label has flipped),
+		// then new hands take the state of their side, if it is free:
+		int slots[FrameData::MAX_HANDS];
+		bool used[2] = { false, false };
+		for (int i=0; i<f.numHands; i++) {
+			slots[i] = constraints.slot(f.hands[i]);
+			if (slots[i] >= 0) {
+				if (used[slots[i]]) slots[i] = -1;
+				else used[slots[i]] = true;
+			}
+		}
+		for (int i=0; i<f.numHands; i++) {
+			if (slots[i] >= 0 || constraints.slot(f.hands[i]) >= 0) continue;
+			const int side = f.hands[i].isRight ? 1 : 0;
+			if (!used[side]) {
+				slots[i] = side;
+				used[side] = true;
+			}
+		}
+		for (int side=0; side<2; side++) if (!used[side]) constraints.lost(side);
+		
+		int bad[SkeletonConstraints::MAX_BAD];
+		t_atom a[2 + SkeletonConstraints::MAX_BAD];
+		for (int i=0; i<f.numHands; i++) {
+			if (slots[i] < 0) continue;
+			HandData& h = f.hands[i];
+			const int count = constraints.apply(h, slots[i], f.timestamp, constrain == 2, bad);
+			if (!count) continue;
+			atom_setsym(a, h.isRight ? ps_right : ps_left);
+			atom_setlong(a+1, h.id);
+			for (int j=0; j<count; j++) {
+				atom_setsym(a+2+j, bad[j] == SkeletonConstraints::SIDE_FLIPPED ? gensym("side") : gensym(jointName(bad[j])));
+			}
+			outlet_anything(outlet_msg, gensym("outliers"), 2 + count, a);
+		}
+	}
+	
+	// update the @motion statistics with every frame, and output them if due
+	void processMotion(bool output) {
+		const FrameData& f = frame_data;
+		bool done[2] = { false, false };
+		for (int i=0; i<f.numHands; i++) {
+			const HandData& h = f.hands[i];
+			const int side = h.isRight ? 1 : 0;
+			if (done[side]) continue;
+			done[side] = true;
+			motion_stats.update(side, h, f.timestamp, (int)motion);
+		}
+		for (int side=0; side<2; side++) {
+			if (!done[side]) motion_stats.clear(side);
+		}
+		if (output) outputMotion();
+	}
+	
+	// (sides without a tracked hand have been cleared, and are skipped)
+	void outputMotion() {
+		for (int side=0; side<2; side++) {
+			/*
+				motion <left|right> jit_matrix <name>: float32, 7 planes, one cell per joint (see jointName)
+				planes: speed mean, speed variance, jerk mean, jerk variance, path length,
+				kinetic energy per unit mass, bounding box volume (meters & seconds)
+			*/
+			void * mat = motion_mats[side];
+			bool ok;
+			long savelock = (long)jit_object_method(mat, _jit_sym_lock, 1);
+			{
+				char * bp;
+				jit_object_method(mat, _jit_sym_getdata, &bp);
+				ok = motion_stats.features(side, (float *)bp);
+			}
+			jit_object_method(mat, _jit_sym_lock, savelock);
+			if (!ok) continue;
+			
+			t_atom a[3];
+			atom_setsym(a, side ? ps_right : ps_left);
+			atom_setsym(a+1, _jit_sym_jit_matrix);
+			atom_setsym(a+2, jit_attr_getsym(motion_wrappers[side], _jit_sym_name));
+			outlet_anything(outlet_msg, gensym("motion"), 3, a);
+		}
+	}
+	
+	/*
+		@strokes: a stroke per hand follows the @stroke_finger tip while pinching (@strokes 1,
+		pinchStrength above 0.8 until it drops below 0.6) or touching (@strokes 2, touchZone touching)
+		from the gestures outlet:	stroke start|end <left|right> <hand id>
+		from the leftmost outlet:	stroke <left|right> jit_matrix <name>	(float32, 3 planes, one cell per vertex,
+									e.g. for jit.gl.path or jit.gl.mesh @draw_mode line_strip; also sent once at the end)
+	*/
+	void processStrokes(bool output) {
+		const FrameData& f = frame_data;
+		const HandData * sides[2] = { NULL, NULL };
+		for (int i=0; i<f.numHands; i++) {
+			const int side = f.hands[i].isRight ? 1 : 0;
+			if (!sides[side]) sides[side] = &f.hands[i];
+		}
+		for (int side=0; side<2; side++) {
+			const HandData * h = sides[side];
+			StrokeBuilder& stroke = stroke_builders[side];
+			const bool drawing = stroke_ids[side] >= 0;
+			bool on = false;
+			if (h && (!drawing || h->id == stroke_ids[side])) {
+				if (strokes == 2) on = h->fingers[stroke_finger].touchZone == Leap::Pointable::ZONE_TOUCHING;
+				else on = h->pinchStrength > (drawing ? 0.6f : 0.8f);
+			}
+			const float * tip = h ? h->fingers[stroke_finger].tipPosition : NULL;
+			if (on && !drawing) {
+				stroke.spacing = stroke_spacing;
+				stroke.subdivisions = (int)stroke_subdivisions;
+				stroke.begin(tip);
+				stroke_ids[side] = h->id;
+				strokeEvent(ps_start, side);
+			} else if (on) {
+				stroke.add(tip);
+			} else if (drawing) {
+				stroke.end();
+				outputStroke(side, true);
+				strokeEvent(ps_end, side);
+				stroke_ids[side] = -1;
+			}
+		}
+		if (output) outputStrokes();
+	}
+	
+	// the strokes being drawn, as they are so far
+	void outputStrokes() {
+		for (int side=0; side<2; side++) {
+			if (stroke_ids[side] >= 0) outputStroke(side, false);
+		}
+	}
+	
+	void strokeEvent(t_symbol * what, int side) {
+		t_atom a[3];
+		atom_setsym(a, what);
+		atom_setsym(a+1, side ? ps_right : ps_left);
+		atom_setlong(a+2, stroke_ids[side]);
+		outlet_anything(outlet_gesture, gensym("stroke"), 3, a);
+	}
+	
+	// (once ended, the stroke is just its spline)
+	void outputStroke(int side, bool ended) {
+		const StrokeBuilder& stroke = stroke_builders[side];
+		const long cells = ended ? (long)stroke.vertices.size()/3 : (long)stroke.count();
+		if (cells != stroke_cells[side] || !stroke_mats[side]) {
+			stroke_cells[side] = cells;
+			stroke_mats[side] = configureMatrix2D(stroke_wrappers[side], 3, _jit_sym_float32, cells, 1);
+		}
+		void * mat = stroke_mats[side];
+		long savelock = (long)jit_object_method(mat, _jit_sym_lock, 1);
+		{
+			char * bp;
+			jit_object_method(mat, _jit_sym_getdata, &bp);
+			if (ended) memcpy(bp, &stroke.vertices[0], stroke.vertices.size()*sizeof(float));
+			else stroke.snapshot((float *)bp);
+		}
+		jit_object_method(mat, _jit_sym_lock, savelock);
+		
+		t_atom a[3];
+		atom_setsym(a, side ? ps_right : ps_left);
+		atom_setsym(a+1, _jit_sym_jit_matrix);
+		atom_setsym(a+2, jit_attr_getsym(stroke_wrappers[side], _jit_sym_name));
+		outlet_anything(outlet_msg, gensym("stroke"), 3, a);
+	}
+	
+	// use the current hands as the rest pose of @retarget
+	void retargetRest() {
+		for (int i=0; i<frame_data.numHands; i++) retargeter.capture(frame_data.hands[i]);
+	}
+	
+	void retargetOffset(t_symbol * side, long node, float x, float y, float z, float w) {
+		if (node < 0 || node >= Retargeter::NUM_NODES) {
+			object_error(&ob, "retarget_offset: node must be 0..%d", Retargeter::NUM_NODES-1);
+			return;
+		}
+		float * q = retargeter.rest[side == ps_right ? 1 : 0][node];
+		float m = sqrtf(x*x + y*y + z*z + w*w);
+		if (m <= 0.f) return;
+		q[0] = x/m; q[1] = y/m; q[2] = z/m; q[3] = w/m;
+	}
+	
+	// the continuous outputs of frame_data
+	void outputSkeleton(const Leap::Frame& frame) {
+		// @normalized applies to the hand output only, everything else works in meters:
+		const FrameData * f = &frame_data;
+		if (normalized && !aka) {
+			frame_normalized = frame_data;
+			normalizeFrame(frame_normalized, clamp != 0);
+			f = &frame_normalized;
+		}
+		if (aka) {
+			processNextFrameAKA(frame);
+		} else if (flat) {
+			processNextFrameFlat(frame, *f);
+		} else {
+			processNextFrame(frame, *f);
+		}
+		if (mesh) processMesh();
+		if (retarget) processRetarget();
+		if (features_count) processFeatures();
+	}
+	
+	static void resampleTick(t_leap * x) {
+		x->resampleStep();
+	}
+	
+	// @resample: one interpolated frame per tick, until @resample is turned off
+	// or input stops (it restarts with the next frame)
+	void resampleStep() {
+		const double now = systimer_gettime();
+		if (resample <= 0.f || aka || !resampler.count || now * 1000. - resampler.arrived > 250000.) {
+			resample_running = false;
+			return;
+		}
+		frame_latest = frame_data;
+		resampler.interpolate(now * 1000., frame_data);
+		outputSkeleton(resample_frame);
+		frame_data = frame_latest;
+		// @motion & @strokes are updated with every tracked frame, but sent at the ticks:
+		if (motion > 0) outputMotion();
+		if (strokes) outputStrokes();
+		
+		const double period = 1000. / resample;
+		resample_next += period;
+		if (resample_next < now) resample_next = now + period;	// fell behind
+		clock_fdelay(resample_clock, resample_next - now);
+	}
+	
+	// the groups of @features, ignoring unknown names; returns the size of one hand's slot
+	int featureGroups(int * groups, int& count) {
+		int size = 0;
+		count = 0;
+		for (long i=0; i<features_count; i++) {
+			const int g = FeatureVector::group(features[i]);
+			if (g < 0) continue;
+			groups[count++] = g;
+			size += FeatureVector::groupSize(g);
+		}
+		return size;
+	}
+	
+	// features jit_matrix <name>: float32, 1 plane, the left hand's slot then the right hand's
+	void processFeatures() {
+		int groups[FeatureVector::NUM_GROUPS];
+		int count;
+		const int slot = featureGroups(groups, count);
+		if (!slot) return;
+		if (!features_mat || features_cells != slot*2) {
+			features_cells = slot*2;
+			features_mat = configureMatrix2D(features_wrapper, 1, _jit_sym_float32, features_cells, 1);
+		}
+		
+		const FrameData& f = frame_data;
+		const HandData * sides[2] = { NULL, NULL };
+		for (int i=0; i<f.numHands; i++) {
+			const int side = f.hands[i].isRight ? 1 : 0;
+			if (!sides[side]) sides[side] = &f.hands[i];
+		}
+		long savelock = (long)jit_object_method(features_mat, _jit_sym_lock, 1);
+		{
+			char * bp;
+			jit_object_method(features_mat, _jit_sym_getdata, &bp);
+			float * out = (float *)bp;
+			for (int side=0; side<2; side++, out += slot) {
+				const HandData * h = sides[side];
+				if (!h) {
+					memset(out, 0, sizeof(float)*slot);
+					continue;
+				}
+				const FeatureVector::PalmFrame frame(*h);
+				float * v = out;
+				for (int i=0; i<count; i++) v = FeatureVector::fill(groups[i], *h, frame, v);
 			}
 		}
+		jit_object_method(features_mat, _jit_sym_lock, savelock);
 		
-		distortion_requested = 0;
+		t_atom a[2];
+		atom_setsym(a, _jit_sym_jit_matrix);
+		atom_setsym(a+1, jit_attr_getsym(features_wrapper, _jit_sym_name));
+		outlet_anything(outlet_msg, gensym("features"), 2, a);
 	}
 	
-	void processGestures(const Leap::Frame& frame) {
-		const Leap::GestureList& gestures = frame.gestures(lastFrame);
-		for(Leap::GestureList::const_iterator gl = gestures.begin(); gl != gestures.end(); gl++) {
-			if ((*gl).isValid()) {
-				dictionary_clear(gesture_dict);
-				
-				t_atom a[2];
-				atom_setsym(a, _sym_dictionary);
-				atom_setsym(a+1, gesture_dict_name);
-				
-				switch ((*gl).state()) {
-					case Leap::Gesture::STATE_START:
-						dictionary_appendsym(gesture_dict, gensym("state"), gensym("start"));
-						break;
-					case Leap::Gesture::STATE_UPDATE:
-						dictionary_appendsym(gesture_dict, gensym("state"), gensym("update"));
-						break;
-					case Leap::Gesture::STATE_STOP:
-						dictionary_appendsym(gesture_dict, gensym("state"), gensym("stop"));
-						break;
-					default:
-						break;
-				}
-				
-				t_atom avec[3];
-				
-				switch ((*gl).type()) {
-					case Leap::Gesture::TYPE_SWIPE: {
-						dictionary_appendsym(gesture_dict, gensym("type"), gensym("swipe"));
-						const Leap::SwipeGesture& g = *(gl);
-						
-						dictionary_appendlong(gesture_dict, _sym_id, g.id());
-						
-						Leap::Vector position = g.position();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, _jit_sym_position, 3, avec);
-						
-						Leap::Vector direction = g.direction();
-						atom_setfloat(avec, direction.x);
-						atom_setfloat(avec+1, direction.y);
-						atom_setfloat(avec+2, direction.z);
-						dictionary_appendatoms(gesture_dict, _jit_sym_direction, 3, avec);
-						
-						Leap::HandList hands = g.hands();
-						if (hands.count()) dictionary_appendlong(gesture_dict, gensym("hand"), (*hands.begin()).id());
-						dictionary_appendlong(gesture_dict, gensym("pointable"), g.pointable().id());
-						
-						position = g.startPosition();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, gensym("startPosition"), 3, avec);
-						dictionary_appendfloat(gesture_dict, gensym("duration"), g.durationSeconds());
-						dictionary_appendfloat(gesture_dict, gensym("speed"), g.speed());
-						
-						outlet_anything(outlet_gesture, gensym("swipe"), 2, a);
-						
-					} break;
-					case Leap::Gesture::TYPE_CIRCLE: {
-						dictionary_appendsym(gesture_dict, gensym("type"), gensym("circle"));
-						const Leap::CircleGesture& g = *(gl);
-						
-						dictionary_appendlong(gesture_dict, _sym_id, g.id());
-						
-						Leap::Vector position = g.center();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, gensym("center"), 3, avec);
-						
-						position = g.normal();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, gensym("normal"), 3, avec);
-						
-						Leap::HandList hands = g.hands();
-						if (hands.count()) dictionary_appendlong(gesture_dict, gensym("hand"), (*hands.begin()).id());
-						dictionary_appendlong(gesture_dict, gensym("pointable"), g.pointable().id());
-						dictionary_appendfloat(gesture_dict, gensym("duration"), g.durationSeconds());
-						dictionary_appendfloat(gesture_dict, gensym("progress"), g.progress());
-						dictionary_appendfloat(gesture_dict, gensym("radius"), g.radius());
-						
-						outlet_anything(outlet_gesture, gensym("circle"), 2, a);
-						
-					} break;
-					case Leap::Gesture::TYPE_KEY_TAP: {
-						dictionary_appendsym(gesture_dict, gensym("type"), gensym("key_tap"));
-						const Leap::KeyTapGesture& g = *(gl);
-						
-						dictionary_appendlong(gesture_dict, _sym_id, g.id());
-						
-						Leap::Vector position = g.position();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, _jit_sym_position, 3, avec);
-						
-						position = g.direction();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, gensym("direction"), 3, avec);
-						
-						Leap::HandList hands = g.hands();
-						if (hands.count()) dictionary_appendlong(gesture_dict, gensym("hand"), (*hands.begin()).id());
-						dictionary_appendlong(gesture_dict, gensym("pointable"), g.pointable().id());
-						dictionary_appendfloat(gesture_dict, gensym("duration"), g.durationSeconds());
-						
-						outlet_anything(outlet_gesture, gensym("key_tap"), 2, a);
-					} break;
-					case Leap::Gesture::TYPE_SCREEN_TAP: {
-						dictionary_appendsym(gesture_dict, gensym("type"), gensym("screen_tap"));
-						const Leap::ScreenTapGesture& g = *(gl);
-						
-						dictionary_appendlong(gesture_dict, _sym_id, g.id());
-						
-						Leap::Vector position = g.position();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, _jit_sym_position, 3, avec);
-						
-						position = g.direction();
-						atom_setfloat(avec, position.x);
-						atom_setfloat(avec+1, position.y);
-						atom_setfloat(avec+2, position.z);
-						dictionary_appendatoms(gesture_dict, gensym("direction"), 3, avec);
-						
-						Leap::HandList hands = g.hands();
-						if (hands.count()) dictionary_appendlong(gesture_dict, gensym("hand"), (*hands.begin()).id());
-						dictionary_appendlong(gesture_dict, gensym("pointable"), g.pointable().id());
-						dictionary_appendfloat(gesture_dict, gensym("duration"), g.durationSeconds());
-						
-						outlet_anything(outlet_gesture, gensym("screen_tap"), 2, a);
-					} break;
-					default: {
-						//Handle unrecognized gestures?
-					} break;
+	// feature_names <name>...: what each value of the @features matrix is
+	void featureNames() {
+		int groups[FeatureVector::NUM_GROUPS];
+		int count;
+		featureGroups(groups, count);
+		std::vector<std::string> names;
+		for (int side=0; side<2; side++) {
+			for (int i=0; i<count; i++) FeatureVector::names(groups[i], side ? "right" : "left", names);
+		}
+		std::vector<t_atom> a(names.size() + 1);
+		for (size_t i=0; i<names.size(); i++) atom_setsym(&a[i], gensym(names[i].c_str()));
+		outlet_anything(outlet_msg, gensym("feature_names"), (short)names.size(), &a[0]);
+	}
+	
+	// compose @axes and the world pose into world; false if there is nothing to do
+	// (the UDP & shared-memory streams and gesture dictionaries stay in tracking space)
+	bool updateWorld() {
+		if (!axes && world_pose.isIdentity()) return false;
+		WorldTransform::axes((int)axes, world_axes);
+		world.compose(world_pose, world_axes);
+		return true;
+	}
+	
+	// live frames are converted via the hub, replayed frames locally
+	void processFrame(const Leap::Frame& frame, int serialize, bool live, const Leap::Frame& since = Leap::Frame::invalid()) {
+		if (!frame.isValid()) return;
+		if (live) {
+			hub->convert(frame, frame_data);
+		} else {
+			convertFrame(frame, frame_data);
+		}
+		if (constrain) processConstraints();
+		if (updateWorld()) world.apply(frame_data);
+		processGestures(frame, since);
+		
+		// @serialize is a recording stream, so it sees every frame too:
+		if (serialize && !aka) serializeAndOutput(frame);
+		if (motion_tracking && !aka && !flat) outputMotionTracking(frame);
+		
+		// continuous outputs are resampled to @resample or decimated to @rate_skeleton,
+		// discrete events always see every frame:
+		const bool resampling = resample > 0.f && !aka;
+		const bool averaging = !resampling && rate_average && rate_skeleton > 0.f;
+		if (averaging) point_averager.add(frame_data);
+		const bool skeleton = !resampling && skeleton_rate.due(rate_skeleton, frame_data.timestamp);
+		if (resampling) {
+			// output comes from resampleTick:
+			resampler.push(frame_data, systimer_gettime() * 1000.);
+			resample_frame = frame;
+			if (!resample_running) {
+				resample_running = true;
+				resample_next = systimer_gettime();
+				clock_delay(resample_clock, 0);
+			}
+		} else if (skeleton) {
+			if (averaging) {
+				frame_latest = frame_data;
+				point_averager.apply(frame_data);
+				point_averager.reset();
+			}
+			outputSkeleton(frame);
+			if (averaging) frame_data = frame_latest;
+		}
+		
+		if (motion > 0) processMotion(skeleton);
+		if (strokes) processStrokes(skeleton);
+		if (pose || pose_recording) processPoses();
+		if (zone_set.zones.size() || zone_set.exits.size()) processZones();
+		if (rule_engine.rules.size()) processRules();
+		if (exporter) exporter->append(frame_data);
+		if (recording && live) recordFrame(frame);
+	}
+	
+	// export live or replayed (jit_matrix) frames to a columnar file:
+	void exportStart(t_symbol * s) {
+		char filename[MAX_FILENAME_CHARS];
+		char fullpath[MAX_PATH_CHARS];
+		short path = 0;
+		if (!resolveFile(s, true, "session.leapcol", filename, &path)) return;
+		if (path_toabsolutesystempath(path, filename, fullpath)) {
+			object_error(&ob, "export: invalid path %s", filename);
+			return;
+		}
+		FILE * file = fopen(fullpath, "wb");
+		if (!file) {
+			object_error(&ob, "export: can't open %s for writing", fullpath);
+			return;
+		}
+		exportStop();
+		exporter = new ColumnarWriter(file);
+		object_post(&ob, "exporting to %s", fullpath);
+	}
+	
+	void exportStop() {
+		if (!exporter) return;
+		uint64_t rows = exporter->numRows + exporter->filling->rows;
+		delete exporter;
+		exporter = NULL;
+		object_post(&ob, "export finished (%ld rows)", (long)rows);
+	}
+
+	bool openFile(t_symbol * s, bool forWriting, const char * defaultName, const char * what, char * fullpath) {
+		char filename[MAX_FILENAME_CHARS];
+		short path = 0;
+		if (!resolveFile(s, forWriting, defaultName, filename, &path)) return false;
+		if (path_toabsolutesystempath(path, filename, fullpath)) {
+			object_error(&ob, "%s: invalid path %s", what, filename);
+			return false;
+		}
+		return true;
+	}
+	
+	// record live frames to a session file (see RECORDING_VERSION), for batch processing
+	void recordStart(t_symbol * s) {
+		char fullpath[MAX_PATH_CHARS];
+		if (!openFile(s, true, "session.leaprec", "record", fullpath)) return;
+		FILE * file = fopen(fullpath, "wb");
+		if (!file) {
+			object_error(&ob, "record: can't open %s for writing", fullpath);
+			return;
+		}
+		recordStop();
+		recording = new RecordingWriter(file);
+		recorded = 0;
+		object_post(&ob, "recording to %s", fullpath);
+	}
+	
+	// (images output for this frame were already added by processImageList)
+	void recordFrame(const Leap::Frame& frame) {
+		recording->addFrame(frame.serialize());
+		recorded++;
+	}
+	
+	void recordStop() {
+		if (!recording) return;
+		const long dropped = recording->dropped;
+		delete recording;
+		recording = NULL;
+		object_post(&ob, "recording finished (%ld frames, %ld images skipped)", recorded, dropped);
+	}
+	
+	// replay a recording in real time, images included, as if it were live
+	// (but through the replay path, like jit_matrix); outputs "play_done <frames>" at the end
+	void playStart(t_symbol * s) {
+		char fullpath[MAX_PATH_CHARS];
+		if (!openFile(s, false, "session.leaprec", "play", fullpath)) return;
+		playStop();
+		RecordingReader * reader = new RecordingReader;
+		if (!reader->open(fullpath) || !reader->next()) {
+			object_error(&ob, "play: %s is not a session recording", fullpath);
+			delete reader;
+			return;
+		}
+		playback = reader;
+		played = 0;
+		clock_delay(play_clock, 0);
+	}
+	
+	void playStop() {
+		clock_unset(play_clock);
+		delete playback;
+		playback = NULL;
+	}
+	
+	static void playTick(t_leap * x) {
+		x->playStep();
+	}
+	
+	void playStep() {
+		RecordingReader * reader = playback;
+		if (!reader) return;
+		if (images) {
+			const uint8_t * decoded[2] = { NULL, NULL };
+			for (size_t i=0; i<reader->numImages; i++) {
+				const uint8_t * pixels;
+				int w, h;
+				const int camera = reader->image(i, &pixels, &w, &h);
+				if (camera >= 0) {
+					outputImage(camera, pixels, w, h);
+					decoded[camera] = pixels;
 				}
 			}
+			if (blobs && (decoded[0] || decoded[1])) processBlobs(decoded, image_width, image_height, NULL);
+		} else {
+			for (size_t i=0; i<reader->numImages; i++) reader->skip(i);
+		}
+		const Leap::Frame frame = reader->frame;
+		processFrame(frame, serialize, false);
+		played++;
+		
+		if (!reader->next()) {
+			t_atom a[1];
+			atom_setlong(a, played);
+			playStop();
+			outlet_anything(outlet_msg, gensym("play_done"), 1, a);
+			return;
+		}
+		// at the recorded pace:
+		double ms = (reader->frame.timestamp() - frame.timestamp()) * 0.001;
+		clock_fdelay(play_clock, ms < 0. ? 0. : ms > 1000. ? 1000. : ms);
+	}
+	
+	// extract features from a recording into a columnar file (see ColumnarWriter),
+	// on worker threads; outputs "batch_done <frames> <rows> <seconds> <unreadable frames>"
+	void batchStart(t_symbol * in, t_symbol * out) {
+		char inpath[MAX_PATH_CHARS];
+		char outpath[MAX_PATH_CHARS];
+		if (batch) {
+			object_error(&ob, "batch: already running (batch_stop to cancel)");
+			return;
 		}
+		if (!openFile(in, false, "session.leaprec", "batch", inpath)) return;
+		if (out == _sym_nothing) {
+			// next to the recording:
+			snprintf(outpath, MAX_PATH_CHARS, "%s", inpath);
+			char * ext = strrchr(outpath, '.');
+			if (ext && !strchr(ext, '/')) *ext = 0;
+			strncat(outpath, ".leapcol", MAX_PATH_CHARS - strlen(outpath) - 1);
+		} else if (!openFile(out, true, "session.leapcol", "batch", outpath)) {
+			return;
+		}
+		FILE * file = fopen(outpath, "wb");
+		if (!file) {
+			object_error(&ob, "batch: can't open %s for writing", outpath);
+			return;
+		}
+		batch = new BatchJob(inpath, new ColumnarWriter(file, false), batch_threads > 0 ? batch_threads : numCores(), batch_qelem);
+		if (!batch->index()) {
+			object_error(&ob, "batch: %s is not a session recording", inpath);
+			delete batch;
+			batch = NULL;
+			return;
+		}
+		object_post(&ob, "batch: %ld frames from %s to %s", (long)batch->offsets.size(), inpath, outpath);
+		batch->start();
+	}
+	
+	void batchStop() {
+		if (!batch) return;
+		delete batch;	// cancels, and closes the output as it stands
+		batch = NULL;
+		object_post(&ob, "batch cancelled");
+	}
+	
+	static void batchDoneTick(t_leap * x) {
+		BatchJob * job = x->batch;
+		if (!job || !job->finished) return;
+		t_atom a[4];
+		atom_setlong(a+0, (long)job->offsets.size());
+		atom_setlong(a+1, (long)job->writer->numRows);
+		atom_setfloat(a+2, job->seconds);
+		atom_setlong(a+3, job->failed);
+		x->batch = NULL;
+		delete job;
+		outlet_anything(x->outlet_msg, gensym("batch_done"), 4, a);
 	}
 	
     void bang() {
 		t_atom a[1];
-		atom_setlong(a, controller.isConnected());
-		outlet_anything(outlet_msg, ps_connected, 1, a);
+		const bool connected = hub->controller.isConnected();
+		// status at @rate_status, but connection changes right away:
+		const bool status = (connected != last_connected) || status_rate.due(rate_status, (int64_t)(systimer_gettime() * 1000.));
+		last_connected = connected;
+		if (status) {
+			atom_setlong(a, connected);
+			outlet_anything(outlet_msg, ps_connected, 1, a);
+		}
 		
-		if(!controller.isConnected()) return;
+		if(!connected) return;
 			
-		Leap::Frame frame = controller.frame();
-		float fps = frame.currentFramesPerSecond();
-		atom_setfloat(a, fps);
-		outlet_anything(outlet_msg, ps_fps, 1, a);
+		Leap::Frame frame = hub->controller.frame();
+		if (status) {
+			float fps = frame.currentFramesPerSecond();
+			atom_setfloat(a, fps);
+			outlet_anything(outlet_msg, ps_fps, 1, a);
+		}
 		
 		int64_t currentID = frame.id();
 		if ((!unique) || currentID > lastFrameID) {		// is this frame new?
 			if (allframes) {
-				// output all pending frames:
-				for (int history = 0; history < currentID - lastFrameID; history++) {
+				// output all pending frames, oldest first
+				// (the controller only keeps a limited history):
+				int pending = (lastFrameID == 0) ? 1 : (int)(currentID - lastFrameID);
+				if (pending > 59) pending = 59;
+				for (int history = pending-1; history >= 0; history--) {
 					// important that we re-use the frame variable here:
-					frame = controller.frame(history);
-					if (images) {
+					frame = hub->controller.frame(history);
+					if (images && image_rate.due(rate_images, frame.timestamp())) {
 						// get most recent images:
 						processImageList(frame.images());
 					}				
-					if (aka) {
-						processNextFrameAKA(frame);
-					} else {
-						processNextFrame(frame, serialize);
-					}
+					processFrame(frame, serialize, true);
 				}
 			} else {
-				if (images) {
+				if (images && image_rate.due(rate_images, frame.timestamp())) {
 					// get most recent images:
-					processImageList(controller.images());
+					processImageList(hub->controller.images());
 				}				
 				// The latest frame only
-				if (aka) {
-					processNextFrameAKA(frame);
-				} else {
-					processNextFrame(frame, serialize);
-				}
+				// (including gestures from any frames skipped since the last poll)
+				processFrame(frame, serialize, true, lastFrame);
 			}
 		}
 		
-		processGestures(frame);
-		
 		lastFrame = frame;
 		lastFrameID = currentID;
     }
@@ -1302,11 +6370,7 @@ public:
 		
 		frame.deserialize(in_bp->data, in_bp->length);
 		//frame.deserialize(in_bp->data, in_bp->length);
-		if (aka) {
-			processNextFrameAKA(frame);
-		} else {
-			processNextFrame(frame, 0);
-		}
+		processFrame(frame, 0, false);
 		
 	unlock:
 		// restore matrix lock state:
@@ -1321,6 +6385,8 @@ public:
 		t_dictionary *d = dictobj_findregistered_retain(s);
 		if (d) {
 			dictionary_clone_to_existing(d,config_dict);
+			parseConfig();
+			configure();
 		} else {
 			object_error(&ob, "unable to reference dictionary named %s", s->s_name);
 			return JIT_ERR_GENERIC;
@@ -1330,6 +6396,194 @@ public:
 	}
 };
 
+t_leap::Hub * t_leap::Hub::instance = NULL;
+
+// [leap~]: selected hand channels as signals
+// frames are taken from the shared hub on the Leap thread and passed through a lock-free queue
+// to the audio thread, which plays them back @latency ms behind the newest frame,
+// interpolating linearly between frame timestamps at every sample
+class t_leap_tilde {
+public:
+	
+	enum { MAX_CHANNELS = 32, HISTORY = 16 };
+	
+	// channels that aren't joint coordinates:
+	enum { CH_NONE = -1, CH_GRAB = -2, CH_PINCH = -3, CH_CONFIDENCE = -4, CH_PRESENT = -5 };
+	
+	enum { HAND_ANY, HAND_LEFT, HAND_RIGHT };
+	
+	struct Channel {
+		int joint;	// a t_leap joint index, or one of CH_*
+		int axis;
+	};
+	
+	struct Sample {
+		int64_t time;	// microseconds, Leap service clock
+		float values[MAX_CHANNELS];
+	};
+	
+	// Leap thread side: picks the hand, extracts the channel values & queues them
+	struct Sink : public t_leap::FrameSink {
+	public:
+		t_leap::FrameQueue<Sample, 64> queue;
+		Channel		channels[MAX_CHANNELS];
+		int			numChannels;
+		float		last[MAX_CHANNELS];	// held while the hand is missing
+		long		hand;
+		long		dropped;
+		
+		Sink() : numChannels(0), hand(HAND_ANY), dropped(0) {
+			for (int i=0; i<MAX_CHANNELS; i++) last[i] = 0.f;
+		}
+		
+		virtual void push(const t_leap::FrameData& f) {
+			const t_leap::HandData * h = NULL;
+			for (int i=0; i<f.numHands && !h; i++) {
+				const t_leap::HandData& candidate = f.hands[i];
+				if (hand == HAND_ANY ? (candidate.id == f.frontmost) : (candidate.isRight == (hand == HAND_RIGHT))) h = &candidate;
+			}
+			Sample sample;
+			sample.time = f.timestamp;
+			for (int c=0; c<numChannels; c++) {
+				const Channel& ch = channels[c];
+				float v = last[c];
+				if (ch.joint == CH_PRESENT) {
+					v = h ? 1.f : 0.f;
+				} else if (h) {
+					switch (ch.joint) {
+						case CH_NONE: v = 0.f; break;
+						case CH_GRAB: v = h->grabStrength; break;
+						case CH_PINCH: v = h->pinchStrength; break;
+						case CH_CONFIDENCE: v = h->confidence; break;
+						default: v = t_leap::jointPosition(*h, ch.joint)[ch.axis]; break;
+					}
+				}
+				sample.values[c] = last[c] = v;
+			}
+			if (!queue.push(sample)) dropped++;
+		}
+		
+		// e.g. palm_x, wrist_y, index_4_z, index_z (= tip), grab, pinch, confidence, present
+		static bool parse(t_symbol * name, Channel& ch) {
+			const char * str = name->s_name;
+			ch.joint = CH_NONE;
+			ch.axis = 0;
+			if (!strcmp(str, "grab")) ch.joint = CH_GRAB;
+			else if (!strcmp(str, "pinch")) ch.joint = CH_PINCH;
+			else if (!strcmp(str, "confidence")) ch.joint = CH_CONFIDENCE;
+			else if (!strcmp(str, "present")) ch.joint = CH_PRESENT;
+			if (ch.joint != CH_NONE) return true;
+			
+			size_t len = strlen(str);
+			if (len < 3 || str[len-2] != '_' || str[len-1] < 'x' || str[len-1] > 'z') return false;
+			ch.axis = str[len-1] - 'x';
+			std::string joint(str, len-2);
+			for (int j=0; j<t_leap::NUM_JOINTS; j++) {
+				const char * jname = t_leap::jointName(j);
+				// a bare finger name means its tip:
+				if (joint == jname || (j >= t_leap::JOINT_FINGERS && (j - t_leap::JOINT_FINGERS) % 5 == 4 && joint + "_4" == jname)) {
+					ch.joint = j;
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+	
+	t_pxobject	ob;			// the object itself (must be first)
+	
+	long		hand;		// which hand to follow
+	float		latency;	// playback delay behind the newest frame, in ms
+	
+	t_symbol *	names[MAX_CHANNELS];
+	Sink		sink;
+	t_leap::Hub * hub;
+	
+	// audio thread only:
+	Sample		history[HISTORY];
+	int			history_write, history_count;
+	double		playhead;	// in Leap microseconds
+	double		samplerate;
+	int			started;
+	
+	t_leap_tilde() {
+		hand = HAND_ANY;
+		latency = 20.f;
+		history_write = history_count = 0;
+		playhead = 0.;
+		samplerate = 44100.;
+		started = 0;
+		hub = NULL;
+	}
+	
+	~t_leap_tilde() {
+		if (hub) {
+			hub->removeSink(&sink);
+			t_leap::Hub::release(NULL);
+		}
+	}
+	
+	// called once the channels are known
+	void start() {
+		hub = t_leap::Hub::acquire(NULL);
+		hub->addSink(&sink);
+		hub->requestConfigure();
+	}
+	
+	const Sample& historyAt(int i) const {
+		return history[(history_write - history_count + i + HISTORY) % HISTORY];
+	}
+	
+	void dsp(double sr) {
+		samplerate = sr;
+		started = 0;
+	}
+	
+	void perform(double ** outs, long numouts, long frames) {
+		sink.hand = hand;
+		
+		Sample sample;
+		while (sink.queue.pop(sample)) {
+			history[history_write] = sample;
+			history_write = (history_write + 1) % HISTORY;
+			if (history_count < HISTORY) history_count++;
+		}
+		if (!history_count) {
+			for (long c=0; c<numouts; c++) memset(outs[c], 0, sizeof(double)*frames);
+			return;
+		}
+		
+		// follow the sensor clock: jump on (re)start or large gaps,
+		// otherwise slowly absorb the drift between the sensor and audio clocks
+		const double target = historyAt(history_count-1).time - latency * 1000.;
+		const double error = target - playhead;
+		if (!started || fabs(error) > 250000.) {
+			playhead = target;
+			started = 1;
+		} else {
+			playhead += error * 0.05;
+		}
+		
+		const double step = 1000000. / samplerate;
+		const int channels = (int)std::min((long)sink.numChannels, numouts);
+		int seg = 0;
+		for (long i=0; i<frames; i++) {
+			while (seg+1 < history_count && historyAt(seg+1).time <= playhead) seg++;
+			const Sample& a = historyAt(seg);
+			if (seg+1 >= history_count || playhead <= a.time) {
+				// hold the first or newest frame
+				for (int c=0; c<channels; c++) outs[c][i] = a.values[c];
+			} else {
+				const Sample& b = historyAt(seg+1);
+				const double t = (playhead - a.time) / (double)(b.time - a.time);
+				for (int c=0; c<channels; c++) outs[c][i] = a.values[c] + (b.values[c] - a.values[c]) * t;
+			}
+			playhead += step;
+		}
+	}
+};
+
+
 //t_max_err leap_notify(t_leap *x, t_symbol *s, t_symbol *msg, void *sender, void *data) {
 //    t_symbol *attrname;
 //    if (msg == _sym_attr_modified) {       // check notification type
@@ -1357,12 +6611,186 @@ void leap_jit_matrix(t_leap *x, t_symbol * s) {
 	x->jit_matrix(s);
 }
 
-void leap_doconfigure(t_leap *x) {
-    x->configure();
+void leap_pose_add(t_leap *x, t_symbol * name) {
+	x->poseRecord(name, 1);
+}
+
+void leap_pose_record(t_leap *x, t_symbol * name, long frames) {
+	x->poseRecord(name, frames ? frames : 30);
+}
+
+void leap_pose_remove(t_leap *x, t_symbol * name) {
+	x->pose_index.remove(name);
+}
+
+void leap_pose_clear(t_leap *x) {
+	x->pose_index.clear();
+	x->pose_recording = NULL;
+}
+
+void leap_pose_dowrite(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	x->poseWrite(s);
+}
+
+void leap_pose_write(t_leap *x, t_symbol * s) {
+	defer(x, (method)leap_pose_dowrite, s, 0, NULL);
+}
+
+void leap_pose_doread(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	x->poseRead(s);
+}
+
+void leap_pose_read(t_leap *x, t_symbol * s) {
+	defer(x, (method)leap_pose_doread, s, 0, NULL);
+}
+
+void leap_stream_target(t_leap *x, t_symbol * host, long port) {
+	x->addStreamTarget(host, port);
+}
+
+void leap_stream_clear(t_leap *x) {
+	x->clearStreamTargets();
+}
+
+void leap_doexport(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	x->exportStart(s);
+}
+
+void leap_export(t_leap *x, t_symbol * s) {
+	defer(x, (method)leap_doexport, s, 0, NULL);
+}
+
+void leap_export_stop(t_leap *x) {
+	x->exportStop();
+}
+
+void leap_zone_sphere(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	if (argc < 1 || atom_gettype(argv) != A_SYM) {
+		object_error((t_object *)x, "zone_sphere <name> <x> <y> <z> <radius>");
+		return;
+	}
+	x->zoneSet(ps_sphere, atom_getsym(argv), argc-1, argv+1);
+}
+
+void leap_zone_box(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	if (argc < 1 || atom_gettype(argv) != A_SYM) {
+		object_error((t_object *)x, "zone_box <name> <x0> <y0> <z0> <x1> <y1> <z1>");
+		return;
+	}
+	x->zoneSet(gensym("box"), atom_getsym(argv), argc-1, argv+1);
+}
+
+void leap_zone_remove(t_leap *x, t_symbol * name) {
+	x->zone_set.remove(name);
+}
+
+void leap_zone_clear(t_leap *x) {
+	x->zone_set.clear();
+}
+
+void leap_zone_cell(t_leap *x, double size) {
+	x->zone_set.cell = (float)size;
+	x->zone_set.build();
+}
+
+void leap_zones(t_leap *x, t_symbol * s) {
+	x->zonesFromDictionary(s);
+}
+
+void leap_rules(t_leap *x, t_symbol * s) {
+	x->rulesFromDictionary(s);
+}
+
+void leap_rules_clear(t_leap *x) {
+	x->rulesClear();
+}
+
+void leap_retarget_rest(t_leap *x) {
+	x->retargetRest();
+}
+
+void leap_retarget_offset(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	if (argc < 6) {
+		object_error((t_object *)x, "retarget_offset <left|right> <node> <qx> <qy> <qz> <qw>");
+		return;
+	}
+	x->retargetOffset(atom_getsym(argv), (long)atom_getlong(argv+1), atom_getfloat(argv+2), atom_getfloat(argv+3), atom_getfloat(argv+4), atom_getfloat(argv+5));
+}
+
+void leap_retarget_clear(t_leap *x) {
+	x->retargeter.clear();
+}
+
+void leap_dorecord(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	x->recordStart(s);
+}
+
+void leap_record(t_leap *x, t_symbol * s) {
+	defer(x, (method)leap_dorecord, s, 0, NULL);
+}
+
+void leap_record_stop(t_leap *x) {
+	x->recordStop();
+}
+
+void leap_dobatch(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	x->batchStart(argc > 0 ? atom_getsym(argv) : _sym_nothing, argc > 1 ? atom_getsym(argv+1) : _sym_nothing);
+}
+
+void leap_batch(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	defer(x, (method)leap_dobatch, s, (short)argc, argv);
+}
+
+void leap_batch_stop(t_leap *x) {
+	x->batchStop();
+}
+
+void leap_doplay(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	x->playStart(s);
+}
+
+void leap_play(t_leap *x, t_symbol * s) {
+	defer(x, (method)leap_doplay, s, 0, NULL);
+}
+
+void leap_play_stop(t_leap *x) {
+	x->playStop();
+}
+
+void leap_blob_reset(t_leap *x) {
+	if (x->blob_tracker) x->blob_tracker->reset = true;
+}
+
+void leap_constrain_reset(t_leap *x) {
+	x->constraints.reset();
+}
+
+// world <4x4 column-major matrix>, world <x y z qx qy qz qw>, or world (identity)
+void leap_world(t_leap *x, t_symbol * s, long argc, t_atom * argv) {
+	float v[16];
+	for (long i=0; i<argc && i<16; i++) v[i] = (float)atom_getfloat(argv+i);
+	if (argc == 16) {
+		x->world_pose.setMatrix(v);
+	} else if (argc == 7) {
+		x->world_pose.setPose(v, v+3);
+	} else if (argc == 0) {
+		x->world_pose.identity();
+	} else {
+		object_error((t_object *)x, "world: expects 16 values (a 4x4 matrix), 7 (x y z qx qy qz qw) or none");
+	}
+}
+
+void leap_feature_names(t_leap *x) {
+	x->featureNames();
+}
+
+void leap_dictionary(t_leap *x, t_symbol * s) {
+	x->dictionary(s);
 }
 
+// configure() is already deferred (and coalesced) by the hub
 void leap_configure(t_leap *x) {
-    defer_low(x, (method)leap_doconfigure, 0, 0, 0);
+    x->configure();
 }
 
 void leap_assist(t_leap *x, void *b, long m, long a, char *s)
@@ -1418,7 +6846,12 @@ t_max_err leap_notify(t_leap *x, t_symbol *s, t_symbol *msg, void *sender, void
 			attrname == gensym("gesture_key_tap") ||
 			attrname == gensym("gesture_screen_tap") ||
 			attrname == gensym("gesture_any")) {
+			if (attrname == gensym("config")) x->loadConfig();
 			x->configure();
+		} else if (attrname == gensym("stream")) {
+			x->updateStreamer();
+		} else if (attrname == gensym("shm")) {
+			x->updateShm();
 		}
 		
 		//object_post((t_object *)x, "changed attr name is %s",attrname->s_name);
@@ -1448,10 +6881,74 @@ void *leap_new(t_symbol *s, long argc, t_atom *argv)
 		
         // apply attrs:
         attr_args_process(x, argc, argv);
+		
+		// the shared controller may already be connected:
+		x->configure();
     }
     return (x);
 }
 
+void leap_tilde_perform64(t_leap_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam) {
+	x->perform(outs, numouts, sampleframes);
+}
+
+void leap_tilde_dsp64(t_leap_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags) {
+	x->dsp(samplerate);
+	object_method(dsp64, gensym("dsp_add64"), x, leap_tilde_perform64, 0, NULL);
+}
+
+void leap_tilde_assist(t_leap_tilde *x, void *b, long m, long a, char *s)
+{
+	if (m == ASSIST_INLET) {
+		sprintf(s, "messages");
+	} else if (a < x->sink.numChannels) {
+		sprintf(s, "%s (signal)", x->names[a]->s_name);
+	}
+}
+
+void leap_tilde_free(t_leap_tilde *x) {
+	z_dsp_free(&x->ob);
+	x->~t_leap_tilde();
+}
+
+// arguments name the output channels, e.g. [leap~ palm_x palm_y palm_z grab pinch index_x]
+void *leap_tilde_new(t_symbol *s, long argc, t_atom *argv)
+{
+	t_leap_tilde *x = NULL;
+	if ((x = (t_leap_tilde *)object_alloc(leap_tilde_class))) {
+		x = new (x) t_leap_tilde();
+		
+		long numargs = attr_args_offset((short)argc, argv);
+		int n = 0;
+		if (numargs == 0) {
+			static const char * defaults[] = { "palm_x", "palm_y", "palm_z", "grab", "pinch" };
+			for (; n<5; n++) x->names[n] = gensym(defaults[n]);
+		} else {
+			for (long i=0; i<numargs && n<t_leap_tilde::MAX_CHANNELS; i++) {
+				if (atom_gettype(argv+i) != A_SYM) {
+					object_error((t_object *)x, "channel names must be symbols");
+					continue;
+				}
+				x->names[n++] = atom_getsym(argv+i);
+			}
+			if (numargs > t_leap_tilde::MAX_CHANNELS) object_warn((t_object *)x, "only the first %d channels are used", t_leap_tilde::MAX_CHANNELS);
+		}
+		for (int i=0; i<n; i++) {
+			if (!t_leap_tilde::Sink::parse(x->names[i], x->sink.channels[i])) {
+				object_error((t_object *)x, "unknown channel %s (outputs zero)", x->names[i]->s_name);
+			}
+		}
+		x->sink.numChannels = n;
+		
+		dsp_setup(&x->ob, 0);
+		for (int i=0; i<n; i++) outlet_new(x, "signal");
+		
+		attr_args_process(x, (short)argc, argv);
+		x->start();
+	}
+	return (x);
+}
+
 int C74_EXPORT main(void) {	
     t_class *maxclass;
 
@@ -1492,9 +6989,41 @@ int C74_EXPORT main(void) {
 	ps_finger = gensym("finger");
 	ps_palm = gensym("palm");
 	ps_ball = gensym("ball");
+	ps_arm = gensym("arm");
+	ps_fingers = gensym("fingers");
+	ps_bones = gensym("bones");
 	ps_fps = gensym("fps");
 	ps_connected = gensym("connected");
 	ps_probability = gensym("probability");
+	ps_pose = gensym("pose");
+	ps_none = gensym("none");
+	ps_left = gensym("left");
+	ps_right = gensym("right");
+	ps_gestures = gensym("gestures");
+	ps_state = gensym("state");
+	ps_start = gensym("start");
+	ps_update = gensym("update");
+	ps_stop = gensym("stop");
+	ps_swipe = gensym("swipe");
+	ps_circle = gensym("circle");
+	ps_key_tap = gensym("key_tap");
+	ps_screen_tap = gensym("screen_tap");
+	ps_pointable = gensym("pointable");
+	ps_duration = gensym("duration");
+	ps_startPosition = gensym("startPosition");
+	ps_speed = gensym("speed");
+	ps_center = gensym("center");
+	ps_normal = gensym("normal");
+	ps_progress = gensym("progress");
+	ps_radius = gensym("radius");
+	ps_zone = gensym("zone");
+	ps_enter = gensym("enter");
+	ps_exit = gensym("exit");
+	ps_inside = gensym("inside");
+	ps_sphere = gensym("sphere");
+	ps_rule = gensym("rule");
+	ps_end = gensym("end");
+	ps_both = gensym("both");
 
 	maxclass = class_new("leap", (method)leap_new, (method)leap_free, (long)sizeof(t_leap), 0L, A_GIMME, 0);
 
@@ -1503,9 +7032,41 @@ int C74_EXPORT main(void) {
 
 	class_addmethod(maxclass, (method)leap_jit_matrix, "jit_matrix", A_SYM, 0);
 	class_addmethod(maxclass, (method)leap_bang, "bang", 0);
-	class_addmethod(maxclass, (method)leap_bang, "getbox", 0);
+	class_addmethod(maxclass, (method)leap_getbox, "getbox", 0);
 	class_addmethod(maxclass, (method)leap_getdistortion, "getdistortion", 0);
 	class_addmethod(maxclass, (method)leap_configure, "configure", 0);
+	class_addmethod(maxclass, (method)leap_dictionary, "dictionary", A_SYM, 0);
+	class_addmethod(maxclass, (method)leap_stream_target, "stream_target", A_SYM, A_LONG, 0);
+	class_addmethod(maxclass, (method)leap_stream_clear, "stream_clear", 0);
+	class_addmethod(maxclass, (method)leap_export, "export", A_DEFSYM, 0);
+	class_addmethod(maxclass, (method)leap_export_stop, "export_stop", 0);
+	class_addmethod(maxclass, (method)leap_zone_sphere, "zone_sphere", A_GIMME, 0);
+	class_addmethod(maxclass, (method)leap_zone_box, "zone_box", A_GIMME, 0);
+	class_addmethod(maxclass, (method)leap_zone_remove, "zone_remove", A_SYM, 0);
+	class_addmethod(maxclass, (method)leap_zone_clear, "zone_clear", 0);
+	class_addmethod(maxclass, (method)leap_zone_cell, "zone_cell", A_FLOAT, 0);
+	class_addmethod(maxclass, (method)leap_zones, "zones", A_SYM, 0);
+	class_addmethod(maxclass, (method)leap_rules, "rules", A_SYM, 0);
+	class_addmethod(maxclass, (method)leap_rules_clear, "rules_clear", 0);
+	class_addmethod(maxclass, (method)leap_retarget_rest, "retarget_rest", 0);
+	class_addmethod(maxclass, (method)leap_retarget_offset, "retarget_offset", A_GIMME, 0);
+	class_addmethod(maxclass, (method)leap_retarget_clear, "retarget_clear", 0);
+	class_addmethod(maxclass, (method)leap_record, "record", A_DEFSYM, 0);
+	class_addmethod(maxclass, (method)leap_record_stop, "record_stop", 0);
+	class_addmethod(maxclass, (method)leap_batch, "batch", A_GIMME, 0);
+	class_addmethod(maxclass, (method)leap_batch_stop, "batch_stop", 0);
+	class_addmethod(maxclass, (method)leap_play, "play", A_DEFSYM, 0);
+	class_addmethod(maxclass, (method)leap_play_stop, "play_stop", 0);
+	class_addmethod(maxclass, (method)leap_blob_reset, "blob_reset", 0);
+	class_addmethod(maxclass, (method)leap_constrain_reset, "constrain_reset", 0);
+	class_addmethod(maxclass, (method)leap_world, "world", A_GIMME, 0);
+	class_addmethod(maxclass, (method)leap_feature_names, "feature_names", 0);
+	class_addmethod(maxclass, (method)leap_pose_add, "pose_add", A_SYM, 0);
+	class_addmethod(maxclass, (method)leap_pose_record, "pose_record", A_DEFSYM, A_DEFLONG, 0);
+	class_addmethod(maxclass, (method)leap_pose_remove, "pose_remove", A_SYM, 0);
+	class_addmethod(maxclass, (method)leap_pose_clear, "pose_clear", 0);
+	class_addmethod(maxclass, (method)leap_pose_write, "pose_write", A_DEFSYM, 0);
+	class_addmethod(maxclass, (method)leap_pose_read, "pose_read", A_DEFSYM, 0);
 
 	CLASS_ATTR_SYM(maxclass, "config", 0, t_leap, config);
 
@@ -1533,6 +7094,118 @@ int C74_EXPORT main(void) {
 	CLASS_ATTR_LONG(maxclass, "aka", 0, t_leap, aka);
 	CLASS_ATTR_STYLE_LABEL(maxclass, "aka", 0, "onoff", "aka: provide output compatible with aka.leapmotion");
 
+	CLASS_ATTR_LONG(maxclass, "flat", 0, t_leap, flat);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "flat", 0, "onoff", "flat: output full hand skeletons as flat lists rather than dictionaries");
+
+	CLASS_ATTR_FLOAT(maxclass, "delta", 0, t_leap, delta);
+	CLASS_ATTR_FILTER_MIN(maxclass, "delta", 0);
+	CLASS_ATTR_LABEL(maxclass, "delta", 0, "delta: if non-zero, only output hand fields that changed by more than this amount");
+	CLASS_ATTR_LONG(maxclass, "delta_refresh", 0, t_leap, delta_refresh);
+	CLASS_ATTR_FILTER_MIN(maxclass, "delta_refresh", 0);
+	CLASS_ATTR_LABEL(maxclass, "delta_refresh", 0, "delta_refresh: with @delta, output all fields every N frames (0 = never)");
+
+	CLASS_ATTR_FLOAT(maxclass, "resample", 0, t_leap, resample);
+	CLASS_ATTR_FILTER_MIN(maxclass, "resample", 0);
+	CLASS_ATTR_LABEL(maxclass, "resample", 0, "resample: output hands at this fixed rate in Hz, interpolated between frames (0 = as tracked)");
+	CLASS_ATTR_FLOAT(maxclass, "rate_images", 0, t_leap, rate_images);
+	CLASS_ATTR_FILTER_MIN(maxclass, "rate_images", 0);
+	CLASS_ATTR_LABEL(maxclass, "rate_images", 0, "rate_images: maximum rate of IR image output in Hz (0 = every frame)");
+	CLASS_ATTR_FLOAT(maxclass, "rate_skeleton", 0, t_leap, rate_skeleton);
+	CLASS_ATTR_FILTER_MIN(maxclass, "rate_skeleton", 0);
+	CLASS_ATTR_LABEL(maxclass, "rate_skeleton", 0, "rate_skeleton: maximum rate of hand, mesh and retarget output in Hz (0 = every frame)");
+	CLASS_ATTR_FLOAT(maxclass, "rate_status", 0, t_leap, rate_status);
+	CLASS_ATTR_FILTER_MIN(maxclass, "rate_status", 0);
+	CLASS_ATTR_LABEL(maxclass, "rate_status", 0, "rate_status: maximum rate of connected/fps output in Hz (0 = every bang)");
+	CLASS_ATTR_LONG(maxclass, "rate_average", 0, t_leap, rate_average);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "rate_average", 0, "onoff", "rate_average: with @rate_skeleton, output positions averaged since the last output rather than the latest");
+
+	CLASS_ATTR_LONG(maxclass, "normalized", 0, t_leap, normalized);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "normalized", 0, "onoff", "normalized: output positions as 0..1 within the interaction box (see getbox)");
+	CLASS_ATTR_LONG(maxclass, "clamp", 0, t_leap, clamp);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "clamp", 0, "onoff", "clamp: with @normalized, clamp positions outside the interaction box to 0..1");
+
+	CLASS_ATTR_LONG(maxclass, "zone_joints", 0, t_leap, zone_joints);
+	CLASS_ATTR_ENUMINDEX2(maxclass, "zone_joints", 0, "palm & tips", "all");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "zone_joints", 0, 1);
+	CLASS_ATTR_LABEL(maxclass, "zone_joints", 0, "zone_joints: joints tested against the trigger zones");
+	CLASS_ATTR_LONG(maxclass, "zone_inside", 0, t_leap, zone_inside);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "zone_inside", 0, "onoff", "zone_inside: also report joints that remain inside a zone, every frame");
+
+	CLASS_ATTR_LONG(maxclass, "blobs", 0, t_leap, blobs);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "blobs", 0, "onoff", "blobs: track bright blobs against a learned background in the IR images");
+	CLASS_ATTR_LONG(maxclass, "blob_threshold", 0, t_leap, blob_threshold);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "blob_threshold", 1, 255);
+	CLASS_ATTR_LABEL(maxclass, "blob_threshold", 0, "blob_threshold: brightness above the background for a pixel to be part of a blob");
+	CLASS_ATTR_FLOAT(maxclass, "blob_adapt", 0, t_leap, blob_adapt);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "blob_adapt", 0, 1);
+	CLASS_ATTR_LABEL(maxclass, "blob_adapt", 0, "blob_adapt: how fast the background model follows the image, per frame");
+	CLASS_ATTR_LONG(maxclass, "blob_min_area", 0, t_leap, blob_min_area);
+	CLASS_ATTR_FILTER_MIN(maxclass, "blob_min_area", 1);
+	CLASS_ATTR_LABEL(maxclass, "blob_min_area", 0, "blob_min_area: smallest blob reported, in pixels");
+	CLASS_ATTR_LONG(maxclass, "blob_stereo", 0, t_leap, blob_stereo);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "blob_stereo", 0, "onoff", "blob_stereo: triangulate blobs seen by both cameras into 3D positions");
+
+	CLASS_ATTR_SYM_VARSIZE(maxclass, "features", 0, t_leap, features, features_count, t_leap::FeatureVector::NUM_GROUPS);
+	CLASS_ATTR_LABEL(maxclass, "features", 0, "features: groups of the fixed-length ML feature vector, in order (present confidence grab pinch extended tips joints quats velocity pinch_distances palm)");
+
+	CLASS_ATTR_LONG(maxclass, "axes", 0, t_leap, axes);
+	CLASS_ATTR_ENUMINDEX3(maxclass, "axes", 0, "leap", "z up", "hmd");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "axes", 0, 2);
+	CLASS_ATTR_LABEL(maxclass, "axes", 0, "axes: axis convention of the output (Leap y up, z up, or head space for a head-mounted sensor), before the world transform");
+
+	CLASS_ATTR_LONG(maxclass, "constrain", 0, t_leap, constrain);
+	CLASS_ATTR_ENUMINDEX3(maxclass, "constrain", 0, "off", "report", "repair");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "constrain", 0, 2);
+	CLASS_ATTR_LABEL(maxclass, "constrain", 0, "constrain: report (and repair) finger joints that break learned bone lengths, bend limits or speed bounds");
+	CLASS_ATTR_FLOAT(maxclass, "constrain_speed", 0, t_leap, constrain_speed);
+	CLASS_ATTR_FILTER_MIN(maxclass, "constrain_speed", 0.1);
+	CLASS_ATTR_LABEL(maxclass, "constrain_speed", 0, "constrain_speed: fastest plausible joint movement at full confidence, in meters per second");
+	CLASS_ATTR_FLOAT(maxclass, "constrain_tolerance", 0, t_leap, constrain_tolerance);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "constrain_tolerance", 0.01, 1);
+	CLASS_ATTR_LABEL(maxclass, "constrain_tolerance", 0, "constrain_tolerance: relative bone length error allowed");
+
+	CLASS_ATTR_LONG(maxclass, "motion", 0, t_leap, motion);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "motion", 0, 1000);
+	CLASS_ATTR_LABEL(maxclass, "motion", 0, "motion: window in frames of the rolling movement statistics per joint (0 = off)");
+
+	CLASS_ATTR_LONG(maxclass, "strokes", 0, t_leap, strokes);
+	CLASS_ATTR_ENUMINDEX3(maxclass, "strokes", 0, "off", "pinch", "touch");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "strokes", 0, 2);
+	CLASS_ATTR_LABEL(maxclass, "strokes", 0, "strokes: draw spline strokes with a fingertip while pinching or touching");
+	CLASS_ATTR_LONG(maxclass, "stroke_finger", 0, t_leap, stroke_finger);
+	CLASS_ATTR_ENUMINDEX(maxclass, "stroke_finger", 0, "thumb index middle ring pinky");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "stroke_finger", 0, 4);
+	CLASS_ATTR_LABEL(maxclass, "stroke_finger", 0, "stroke_finger: the finger that draws strokes");
+	CLASS_ATTR_FLOAT(maxclass, "stroke_spacing", 0, t_leap, stroke_spacing);
+	CLASS_ATTR_FILTER_MIN(maxclass, "stroke_spacing", 0.0001);
+	CLASS_ATTR_LABEL(maxclass, "stroke_spacing", 0, "stroke_spacing: distance between stroke control points (meters, or box units with @normalized)");
+	CLASS_ATTR_LONG(maxclass, "stroke_subdivisions", 0, t_leap, stroke_subdivisions);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "stroke_subdivisions", 1, 16);
+	CLASS_ATTR_LABEL(maxclass, "stroke_subdivisions", 0, "stroke_subdivisions: spline vertices per stroke control point");
+
+	CLASS_ATTR_LONG(maxclass, "retarget", 0, t_leap, retarget);
+	CLASS_ATTR_ENUMINDEX3(maxclass, "retarget", 0, "off", "quat", "matrix");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "retarget", 0, 2);
+	CLASS_ATTR_LABEL(maxclass, "retarget", 0, "retarget: output parent-relative bone transforms for rigged hands, as position + quat or 4x4 matrices");
+
+	CLASS_ATTR_LONG(maxclass, "mesh", 0, t_leap, mesh);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "mesh", 0, "onoff", "mesh: output a triangle mesh of the hands as position, normal and index matrices for jit.gl.mesh");
+	CLASS_ATTR_LONG(maxclass, "mesh_lod", 0, t_leap, mesh_lod);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "mesh_lod", 0, 3);
+	CLASS_ATTR_LABEL(maxclass, "mesh_lod", 0, "mesh_lod: level of detail of the hand mesh (0 = coarsest)");
+
+	CLASS_ATTR_LONG(maxclass, "batch_threads", 0, t_leap, batch_threads);
+	CLASS_ATTR_FILTER_MIN(maxclass, "batch_threads", 0);
+	CLASS_ATTR_LABEL(maxclass, "batch_threads", 0, "batch_threads: worker threads for batch processing (0 = one per core)");
+
+	CLASS_ATTR_LONG(maxclass, "stream", 0, t_leap, stream);
+	CLASS_ATTR_ENUMINDEX3(maxclass, "stream", 0, "off", "osc", "binary");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "stream", 0, 2);
+	CLASS_ATTR_LABEL(maxclass, "stream", 0, "stream: send every frame to the stream_target hosts over UDP, from the capture thread");
+
+	CLASS_ATTR_SYM(maxclass, "shm", 0, t_leap, shm);
+	CLASS_ATTR_LABEL(maxclass, "shm", 0, "shm: publish every frame to a named shared-memory region (see leap_shm.h)");
+
 	CLASS_ATTR_LONG(maxclass, "gesture_swipe", 0, t_leap, gesture_swipe);
 	CLASS_ATTR_STYLE_LABEL(maxclass, "gesture_swipe", 0, "onoff", "gesture_swipe: recognize a long, linear movement of a finger");
 	CLASS_ATTR_LONG(maxclass, "gesture_circle", 0, t_leap, gesture_circle);
@@ -1545,8 +7218,35 @@ int C74_EXPORT main(void) {
 	CLASS_ATTR_LONG(maxclass, "gesture_any", 0, t_leap, gesture_any);
 	CLASS_ATTR_STYLE_LABEL(maxclass, "gesture_any", 0, "onoff", "gesture_any: if enabled, all gestures are recognized.");
 
+	CLASS_ATTR_LONG(maxclass, "pose", 0, t_leap, pose);
+	CLASS_ATTR_STYLE_LABEL(maxclass, "pose", 0, "onoff", "pose: classify recorded static hand poses");
+	CLASS_ATTR_LONG(maxclass, "pose_k", 0, t_leap, pose_k);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "pose_k", 1, t_leap::PoseIndex::MAX_K);
+	CLASS_ATTR_LABEL(maxclass, "pose_k", 0, "pose_k: number of nearest recorded samples that vote on a pose");
+	CLASS_ATTR_FLOAT(maxclass, "pose_threshold", 0, t_leap, pose_threshold);
+	CLASS_ATTR_FILTER_CLIP(maxclass, "pose_threshold", 0, 1);
+	CLASS_ATTR_LABEL(maxclass, "pose_threshold", 0, "pose_threshold: minimum share of the votes to report a pose");
+
 
 	class_register(CLASS_BOX, maxclass); 
 	leap_class = maxclass;
+	
+	maxclass = class_new("leap~", (method)leap_tilde_new, (method)leap_tilde_free, (long)sizeof(t_leap_tilde), 0L, A_GIMME, 0);
+	
+	class_addmethod(maxclass, (method)leap_tilde_dsp64, "dsp64", A_CANT, 0);
+	class_addmethod(maxclass, (method)leap_tilde_assist, "assist", A_CANT, 0);
+	
+	CLASS_ATTR_LONG(maxclass, "hand", 0, t_leap_tilde, hand);
+	CLASS_ATTR_ENUMINDEX3(maxclass, "hand", 0, "any", "left", "right");
+	CLASS_ATTR_FILTER_CLIP(maxclass, "hand", 0, 2);
+	CLASS_ATTR_LABEL(maxclass, "hand", 0, "hand: follow the frontmost, left or right hand");
+	
+	CLASS_ATTR_FLOAT(maxclass, "latency", 0, t_leap_tilde, latency);
+	CLASS_ATTR_FILTER_MIN(maxclass, "latency", 0);
+	CLASS_ATTR_LABEL(maxclass, "latency", 0, "latency: playback delay (ms) behind the newest frame; longer is smoother when frames arrive unevenly");
+	
+	class_dspinit(maxclass);
+	class_register(CLASS_BOX, maxclass);
+	leap_tilde_class = maxclass;
 	return 0;
 }
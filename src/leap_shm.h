@@ -0,0 +1,140 @@
+/**
+	@file
+	leap_shm.h - shared-memory layout of the latest frame published by [leap] @shm <name>
+
+	This header has no Max or Leap dependencies, so that other processes (renderers,
+	ML tools etc.) can include it directly to read the latest skeleton.
+
+	The region holds a single frame guarded by a sequence lock: the writer increments
+	the sequence before and after each update (so it is odd while writing), and
+	readers retry until they copy a frame with the same even sequence before and after.
+	There is one writer ([leap]) and any number of readers, none of which ever block.
+
+	Positions and lengths are in meters, quaternions are x y z w.
+
+	Usage:
+
+		leap_shm_region * region = leap_shm_open("leap");
+		leap_shm_frame frame;
+		if (region && leap_shm_read(region, &frame)) { ... }
+		leap_shm_close(region);
+ */
+
+#ifndef LEAP_SHM_H
+#define LEAP_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#define LEAP_SHM_BARRIER() MemoryBarrier()
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <stdio.h>
+	#define LEAP_SHM_BARRIER() __sync_synchronize()
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LEAP_SHM_MAGIC		0x5041454c	/* "LEAP" */
+#define LEAP_SHM_VERSION	1
+#define LEAP_SHM_MAX_HANDS	4
+#define LEAP_SHM_NUM_JOINTS	28
+#define LEAP_SHM_NUM_BONES	20
+
+typedef struct leap_shm_hand {
+	int32_t	id;
+	int32_t	is_right;
+	float	confidence;
+	float	grab_strength;
+	float	pinch_strength;
+	float	palm_width;
+	float	palm_normal[3];
+	float	direction[3];
+	float	palm_velocity[3];
+	float	palm_quat[4];
+	/* palm, wrist, elbow, then for thumb, index, middle, ring, pinky:
+	   the base of the metacarpal followed by the end of each of the 4 bones */
+	float	joints[LEAP_SHM_NUM_JOINTS][3];
+	/* metacarpal, proximal, intermediate, distal for each finger */
+	float	bone_quats[LEAP_SHM_NUM_BONES][4];
+} leap_shm_hand;
+
+typedef struct leap_shm_frame {
+	int64_t	id;
+	int64_t	timestamp;		/* microseconds, Leap service clock */
+	int32_t	num_hands;
+	int32_t	reserved;
+	leap_shm_hand hands[LEAP_SHM_MAX_HANDS];
+} leap_shm_frame;
+
+typedef struct leap_shm_region {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;			/* sizeof(leap_shm_region) */
+	volatile uint32_t sequence;
+	leap_shm_frame frame;
+} leap_shm_region;
+
+/* copy the latest frame; returns 0 if no consistent frame could be read */
+static inline int leap_shm_read(const leap_shm_region * region, leap_shm_frame * out) {
+	int attempt;
+	if (!region || region->magic != LEAP_SHM_MAGIC || region->version != LEAP_SHM_VERSION) return 0;
+	for (attempt = 0; attempt < 1000; attempt++) {
+		uint32_t before = region->sequence;
+		LEAP_SHM_BARRIER();
+		if (before & 1) continue;
+		memcpy(out, (const void *)&region->frame, sizeof(leap_shm_frame));
+		LEAP_SHM_BARRIER();
+		if (region->sequence == before) return before != 0;
+	}
+	return 0;
+}
+
+/* the sequence changes with every published frame */
+static inline uint32_t leap_shm_sequence(const leap_shm_region * region) {
+	return region ? region->sequence : 0;
+}
+
+/* map an existing region read-only; returns NULL if [leap] hasn't created it */
+static inline leap_shm_region * leap_shm_open(const char * name) {
+#ifdef _WIN32
+	void * ptr;
+	HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if (!h) return NULL;
+	ptr = MapViewOfFile(h, FILE_MAP_READ, 0, 0, sizeof(leap_shm_region));
+	CloseHandle(h);	/* the view keeps the mapping alive */
+	return (leap_shm_region *)ptr;
+#else
+	char path[256];
+	void * ptr;
+	int fd;
+	snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+	fd = shm_open(path, O_RDONLY, 0);
+	if (fd < 0) return NULL;
+	ptr = mmap(NULL, sizeof(leap_shm_region), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return (ptr == MAP_FAILED) ? NULL : (leap_shm_region *)ptr;
+#endif
+}
+
+static inline void leap_shm_close(leap_shm_region * region) {
+	if (!region) return;
+#ifdef _WIN32
+	UnmapViewOfFile(region);
+#else
+	munmap(region, sizeof(leap_shm_region));
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LEAP_SHM_H */